@@ -0,0 +1,641 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/*
+ * Banco de pruebas de carga del servicio: lo arranca en este mismo proceso
+ * con el proveedor PKCS#11 de FIRMADOR_PROVIDER y lanza clientes HTTP
+ * concurrentes por la interfaz local contra /nexu-info, /rest/certificates y
+ * /rest/sign con claves RSA y ECDSA. Informa de peticiones por segundo, de
+ * los percentiles 50, 99 y 99,9 de la latencia y de las asignaciones de
+ * memoria por petición que hace el servicio, con aparte los bloques que las
+ * arenas de las peticiones piden al sistema.
+ *
+ *     bench/http [-c clientes] [-n peticiones por cliente]
+ *
+ * Con FIRMADOR_BENCH_TOKEN genera antes en ese token, que debe estar vacío,
+ * una clave y un certificado de cada tipo. bench/softhsm.sh crea un token de
+ * SoftHSM2 temporal y ejecuta así el banco de pruebas con make bench.
+ */
+
+#include "arena.h"
+#include "prompt.h"
+#include "service.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <gnutls/abstract.h>
+#include <gnutls/pkcs11.h>
+#include <gnutls/x509.h>
+
+#define FIRMADOR_BENCH_CLIENTS 4
+#define FIRMADOR_BENCH_REQUESTS 200
+#define FIRMADOR_BENCH_PIN "1234"
+/* SHA-256 de "firmador", en Base64. */
+#define FIRMADOR_BENCH_DIGEST "/Dq3WgMOevwPpTFLg1VNOofQ0MjZ11G5Tmp3vWxlLtk="
+
+/*
+ * Llamadas a operator new desde los hilos del servicio, los que no marcan
+ * bench_client: libmicrohttpd, los hilos de trabajo y el de las ranuras. Los
+ * bloques que piden las arenas al desbordarse se cuentan con arena_chunks();
+ * la memoria que piden GnuTLS y libmicrohttpd con malloc no se cuenta.
+ */
+static std::atomic<unsigned long> bench_allocations(0);
+static thread_local bool bench_client = false;
+
+void *operator new(std::size_t size) {
+	if (!bench_client) {
+		bench_allocations.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void *memory = malloc(size != 0 ? size : 1);
+	if (memory == NULL) {
+		throw std::bad_alloc();
+	}
+
+	return memory;
+}
+
+void operator delete(void *memory) noexcept {
+	free(memory);
+}
+
+static std::string bench_env(const char *name, const char *fallback) {
+	const char *value = getenv(name);
+	if (value == NULL || value[0] == 0) {
+		return fallback;
+	}
+
+	return value;
+}
+
+/*
+ * PIN de FIRMADOR_BENCH_PIN sin preguntar y certificado elegido por su
+ * algoritmo, para que cada fase firme con el tipo de clave que mide.
+ */
+class BenchPrompt : public Prompt {
+public:
+	BenchPrompt() : algorithm("RSA"),
+		code(bench_env("FIRMADOR_BENCH_PIN", FIRMADOR_BENCH_PIN)) {}
+
+	int pin(const std::string &description, char *pin,
+		std::size_t pin_max) {
+
+		(void) description;
+		if (code.length() >= pin_max) {
+			return -1;
+		}
+		memcpy(pin, code.c_str(), code.length() + 1);
+
+		return 0;
+	}
+
+	int select(const std::vector<certificate_t> &certificates) {
+		std::string prefix = algorithm.load();
+		for (std::size_t i = 0; i < certificates.size(); i++) {
+			if (certificates.at(i).encryptionAlgorithm.compare(0,
+				prefix.length(), prefix) == 0) {
+				return (int) i;
+			}
+		}
+
+		return -1;
+	}
+
+	void choose(const char *prefix) {
+		algorithm = prefix;
+	}
+
+private:
+	std::atomic<const char *> algorithm;
+	const std::string code;
+};
+
+static int bench_pin(void *userdata, int attempt, const char *token_url,
+	const char *token_label, unsigned int flags, char *pin,
+	std::size_t pin_max) {
+
+	(void) attempt;
+	(void) token_url;
+	(void) token_label;
+	if (flags & GNUTLS_PIN_WRONG) {
+		return -1;
+	}
+
+	return static_cast<BenchPrompt *>(userdata)->pin("", pin, pin_max);
+}
+
+/*
+ * Clave generada en el token y certificado autofirmado con ella, con el mismo
+ * identificador y etiqueta, el uso de no repudio y los campos del nombre que
+ * lee el firmador.
+ */
+static int bench_provision_key(const std::string &token,
+	gnutls_pk_algorithm_t algorithm, unsigned int bits, const char *label,
+	unsigned char id) {
+
+	gnutls_datum_t cid = { &id, 1 };
+	gnutls_datum_t der = { NULL, 0 };
+	int ret = gnutls_pkcs11_privkey_generate3(token.c_str(), algorithm,
+		bits, label, &cid, GNUTLS_X509_FMT_DER, &der,
+		GNUTLS_KEY_DIGITAL_SIGNATURE | GNUTLS_KEY_NON_REPUDIATION,
+		GNUTLS_PKCS11_OBJ_FLAG_LOGIN
+		| GNUTLS_PKCS11_OBJ_FLAG_MARK_PRIVATE
+		| GNUTLS_PKCS11_OBJ_FLAG_MARK_SENSITIVE);
+	if (ret < GNUTLS_E_SUCCESS) {
+		return ret;
+	}
+
+	gnutls_pubkey_t pubkey;
+	gnutls_pubkey_init(&pubkey);
+	ret = gnutls_pubkey_import(pubkey, &der, GNUTLS_X509_FMT_DER);
+	gnutls_free(der.data);
+	if (ret < GNUTLS_E_SUCCESS) {
+		gnutls_pubkey_deinit(pubkey);
+		return ret;
+	}
+
+	char hex[3];
+	snprintf(hex, sizeof(hex), "%02x", id);
+	std::string url = token + ";object=" + label + ";id=%" + hex
+		+ ";type=private";
+
+	gnutls_privkey_t privkey;
+	gnutls_privkey_init(&privkey);
+	ret = gnutls_privkey_import_url(privkey, url.c_str(), 0);
+	if (ret < GNUTLS_E_SUCCESS) {
+		gnutls_privkey_deinit(privkey);
+		gnutls_pubkey_deinit(pubkey);
+		return ret;
+	}
+
+	gnutls_x509_crt_t crt;
+	gnutls_x509_crt_init(&crt);
+
+	std::time_t now = std::time(NULL);
+	std::string name = std::string("PRUEBA ") + label;
+	if ((ret = gnutls_x509_crt_set_version(crt, 3)) < GNUTLS_E_SUCCESS
+		|| (ret = gnutls_x509_crt_set_serial(crt, &id, 1))
+			< GNUTLS_E_SUCCESS
+		|| (ret = gnutls_x509_crt_set_activation_time(crt,
+			now - 3600)) < GNUTLS_E_SUCCESS
+		|| (ret = gnutls_x509_crt_set_expiration_time(crt,
+			now + 86400)) < GNUTLS_E_SUCCESS
+		|| (ret = gnutls_x509_crt_set_dn_by_oid(crt,
+			GNUTLS_OID_X520_COMMON_NAME, 0, name.c_str(),
+			name.length())) < GNUTLS_E_SUCCESS
+		|| (ret = gnutls_x509_crt_set_dn_by_oid(crt,
+			GNUTLS_OID_X520_GIVEN_NAME, 0, "PRUEBA", 6))
+			< GNUTLS_E_SUCCESS
+		|| (ret = gnutls_x509_crt_set_dn_by_oid(crt,
+			GNUTLS_OID_X520_SURNAME, 0, label, strlen(label)))
+			< GNUTLS_E_SUCCESS
+		|| (ret = gnutls_x509_crt_set_dn_by_oid(crt, "2.5.4.5", 0,
+			"CPF-00-0000-0000", 16)) < GNUTLS_E_SUCCESS
+		|| (ret = gnutls_x509_crt_set_key_usage(crt,
+			GNUTLS_KEY_DIGITAL_SIGNATURE
+			| GNUTLS_KEY_NON_REPUDIATION)) < GNUTLS_E_SUCCESS
+		|| (ret = gnutls_x509_crt_set_pubkey(crt, pubkey))
+			< GNUTLS_E_SUCCESS
+		|| (ret = gnutls_x509_crt_privkey_sign(crt, crt, privkey,
+			GNUTLS_DIG_SHA256, 0)) < GNUTLS_E_SUCCESS) {
+		gnutls_x509_crt_deinit(crt);
+		gnutls_privkey_deinit(privkey);
+		gnutls_pubkey_deinit(pubkey);
+		return ret;
+	}
+
+	ret = gnutls_pkcs11_copy_x509_crt2(token.c_str(), crt, label, &cid,
+		GNUTLS_PKCS11_OBJ_FLAG_LOGIN);
+
+	gnutls_x509_crt_deinit(crt);
+	gnutls_privkey_deinit(privkey);
+	gnutls_pubkey_deinit(pubkey);
+
+	return ret;
+}
+
+/* Prepara el token con su propia inicialización de PKCS#11. */
+static int bench_provision(const std::string &provider,
+	const std::string &token, BenchPrompt &prompt) {
+
+	gnutls_pkcs11_set_pin_function(bench_pin, &prompt);
+
+	int ret = gnutls_pkcs11_init(GNUTLS_PKCS11_FLAG_MANUAL, NULL);
+	if (ret < GNUTLS_E_SUCCESS) {
+		return ret;
+	}
+
+	ret = gnutls_pkcs11_add_provider(provider.c_str(), NULL);
+	if (ret == GNUTLS_E_SUCCESS) {
+		ret = bench_provision_key(token, GNUTLS_PK_RSA, 2048, "rsa", 1);
+	}
+	if (ret == GNUTLS_E_SUCCESS) {
+		ret = bench_provision_key(token, GNUTLS_PK_ECDSA,
+			GNUTLS_CURVE_TO_BITS(GNUTLS_ECC_CURVE_SECP256R1),
+			"ecdsa", 2);
+	}
+
+	gnutls_pkcs11_deinit();
+
+	return ret;
+}
+
+/*
+ * Socket a la escucha en un puerto libre de la interfaz local que se entrega
+ * al servicio con service_listen, sin tocar los descriptores heredados.
+ */
+static int bench_listen(unsigned short &port) {
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0) {
+		return -1;
+	}
+
+	struct sockaddr_in address;
+	socklen_t length = sizeof(address);
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(fd, (struct sockaddr *) &address, sizeof(address)) != 0
+		|| listen(fd, SOMAXCONN) != 0
+		|| getsockname(fd, (struct sockaddr *) &address,
+			&length) != 0) {
+		close(fd);
+		return -1;
+	}
+	port = ntohs(address.sin_port);
+
+	return fd;
+}
+
+/*
+ * Cliente HTTP/1.1 mínimo para la interfaz local que mantiene la conexión
+ * abierta mientras el servicio no la cierre.
+ */
+class BenchClient {
+public:
+	explicit BenchClient(unsigned short port) : port(port), fd(-1) {}
+	~BenchClient() {
+		disconnect();
+	}
+
+	/* Código de estado de la respuesta, o 0 si falla la conexión. */
+	unsigned int send(const std::string &request, std::string &body);
+
+private:
+	bool connect();
+	void disconnect();
+	bool receive();
+
+	unsigned short port;
+	int fd;
+	std::string buffer;
+};
+
+bool BenchClient::connect() {
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0) {
+		return false;
+	}
+
+	int one = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	struct sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (::connect(fd, (struct sockaddr *) &address,
+		sizeof(address)) != 0) {
+		disconnect();
+		return false;
+	}
+
+	return true;
+}
+
+void BenchClient::disconnect() {
+	if (fd >= 0) {
+		close(fd);
+		fd = -1;
+	}
+	buffer.clear();
+}
+
+bool BenchClient::receive() {
+	char data[4096];
+	ssize_t size;
+	do {
+		size = recv(fd, data, sizeof(data), 0);
+	} while (size < 0 && errno == EINTR);
+	if (size <= 0) {
+		return false;
+	}
+	buffer.append(data, size);
+
+	return true;
+}
+
+unsigned int BenchClient::send(const std::string &request,
+	std::string &body) {
+
+	if (fd < 0 && !connect()) {
+		return 0;
+	}
+
+	std::size_t sent = 0;
+	while (sent < request.length()) {
+		ssize_t size = ::send(fd, request.data() + sent,
+			request.length() - sent, 0);
+		if (size < 0 && errno == EINTR) {
+			continue;
+		}
+		if (size <= 0) {
+			disconnect();
+			return 0;
+		}
+		sent += size;
+	}
+
+	std::size_t end;
+	while ((end = buffer.find("\r\n\r\n")) == std::string::npos) {
+		if (!receive()) {
+			disconnect();
+			return 0;
+		}
+	}
+
+	std::string header = buffer.substr(0, end + 2);
+	std::transform(header.begin(), header.end(), header.begin(),
+		::tolower);
+	unsigned int status = header.compare(0, 5, "http/") == 0
+		&& header.find(' ') != std::string::npos
+		? strtoul(header.c_str() + header.find(' ') + 1, NULL, 10) : 0;
+
+	std::size_t length = 0;
+	std::size_t field = header.find("\r\ncontent-length:");
+	if (field != std::string::npos) {
+		length = strtoul(header.c_str() + field + 17, NULL, 10);
+	}
+	bool close = header.find("\r\nconnection: close\r\n")
+		!= std::string::npos;
+
+	end += 4;
+	while (buffer.length() < end + length) {
+		if (!receive()) {
+			disconnect();
+			return 0;
+		}
+	}
+	body.assign(buffer, end, length);
+	buffer.erase(0, end + length);
+
+	if (close) {
+		disconnect();
+	}
+
+	return status;
+}
+
+static std::string bench_post(const char *path, const std::string &body) {
+	std::ostringstream request;
+	request << "POST " << path << " HTTP/1.1\r\n"
+		"Host: localhost\r\n"
+		"Content-Type: application/json\r\n"
+		"Content-Length: " << body.length() << "\r\n"
+		"\r\n" << body;
+
+	return request.str();
+}
+
+/* Valor de texto que sigue a la clave indicada en la respuesta JSON. */
+static std::string bench_field(const std::string &body, const char *key) {
+	std::string pattern = std::string("\"") + key + "\":\"";
+	std::size_t start = body.find(pattern);
+	if (start == std::string::npos) {
+		return "";
+	}
+	start += pattern.length();
+
+	std::size_t end = body.find('"', start);
+	if (end == std::string::npos) {
+		return "";
+	}
+
+	return body.substr(start, end - start);
+}
+
+static double bench_percentile(const std::vector<double> &sorted,
+	double percentile) {
+
+	if (sorted.empty()) {
+		return 0;
+	}
+
+	std::size_t rank = (std::size_t) std::ceil(percentile * sorted.size());
+
+	return sorted.at(rank > 0 ? rank - 1 : 0);
+}
+
+/*
+ * Cada cliente usa su propia conexión y hace sus peticiones seguidas. Cuenta
+ * como error un código distinto de 200 o, si se indica, una respuesta sin
+ * el texto esperado.
+ */
+static void bench_run(const char *name, unsigned short port,
+	const std::string &request, const char *expected, unsigned int clients,
+	unsigned int requests) {
+
+	std::vector<std::vector<double> > latencies(clients);
+	std::atomic<unsigned int> errors(0);
+	std::vector<std::thread> workers;
+	unsigned long allocations = bench_allocations.load();
+	unsigned long chunks = arena_chunks();
+	std::chrono::steady_clock::time_point start =
+		std::chrono::steady_clock::now();
+
+	for (unsigned int i = 0; i < clients; i++) {
+		std::vector<double> &latency = latencies.at(i);
+		latency.reserve(requests);
+		workers.push_back(std::thread([&, port, requests]() {
+			bench_client = true;
+			BenchClient client(port);
+			std::string body;
+			for (unsigned int j = 0; j < requests; j++) {
+				std::chrono::steady_clock::time_point sent =
+					std::chrono::steady_clock::now();
+				unsigned int status = client.send(request,
+					body);
+				latency.push_back(
+					std::chrono::duration<double,
+					std::milli>(
+					std::chrono::steady_clock::now()
+					- sent).count());
+				if (status != 200 || (expected != NULL
+					&& body.find(expected)
+					== std::string::npos)) {
+					errors++;
+				}
+			}
+		}));
+	}
+	for (std::size_t i = 0; i < workers.size(); i++) {
+		workers.at(i).join();
+	}
+
+	double seconds = std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - start).count();
+	allocations = bench_allocations.load() - allocations;
+	chunks = arena_chunks() - chunks;
+
+	std::vector<double> sorted;
+	for (std::size_t i = 0; i < latencies.size(); i++) {
+		sorted.insert(sorted.end(), latencies.at(i).begin(),
+			latencies.at(i).end());
+	}
+	std::sort(sorted.begin(), sorted.end());
+
+	printf("%-24s %8u %10zu %10.0f %8.2f %8.2f %8.2f %8.1f %9.2f %7u\n",
+		name, clients, sorted.size(), sorted.size() / seconds,
+		bench_percentile(sorted, 0.5), bench_percentile(sorted, 0.99),
+		bench_percentile(sorted, 0.999),
+		(double) allocations / sorted.size(),
+		(double) chunks / sorted.size(), errors.load());
+}
+
+static unsigned int bench_number(const char *value, unsigned int fallback) {
+	char *end;
+	unsigned long number = strtoul(value, &end, 10);
+
+	return *end == 0 && number > 0 ? (unsigned int) number : fallback;
+}
+
+int main(int argc, char *argv[]) {
+	unsigned int clients = FIRMADOR_BENCH_CLIENTS;
+	unsigned int requests = FIRMADOR_BENCH_REQUESTS;
+
+	for (int i = 1; i + 1 < argc; i += 2) {
+		if (strcmp(argv[i], "-c") == 0) {
+			clients = bench_number(argv[i + 1], clients);
+		} else if (strcmp(argv[i], "-n") == 0) {
+			requests = bench_number(argv[i + 1], requests);
+		}
+	}
+
+	std::string provider = bench_env("FIRMADOR_PROVIDER", "");
+	if (provider.empty()) {
+		fprintf(stderr, "Indicar el módulo PKCS#11 en "
+			"FIRMADOR_PROVIDER, por ejemplo con "
+			"bench/softhsm.sh.\n");
+		return 1;
+	}
+
+	BenchPrompt prompt;
+	std::string token = bench_env("FIRMADOR_BENCH_TOKEN", "");
+	if (!token.empty()) {
+		int ret = bench_provision(provider, token, prompt);
+		if (ret < GNUTLS_E_SUCCESS) {
+			fprintf(stderr, "Error al preparar el token %s: %s\n",
+				token.c_str(), gnutls_strerror(ret));
+			return 1;
+		}
+	}
+
+	/* El hilo principal solo coordina a los clientes. */
+	bench_client = true;
+
+	unsigned short port;
+	int fd = bench_listen(port);
+	if (fd < 0) {
+		fprintf(stderr, "No se ha podido abrir el puerto local.\n");
+		return 1;
+	}
+	service_listen(fd);
+
+	std::string title;
+	std::string message;
+	if (!service_start(title, message)) {
+		fprintf(stderr, "%s: %s\n", title.c_str(), message.c_str());
+		return 1;
+	}
+	prompt_set(&prompt);
+
+	printf("%-24s %8s %10s %10s %8s %8s %8s %8s %9s %7s\n", "ruta",
+		"clientes", "peticiones", "pet/s", "p50 ms", "p99 ms",
+		"p999 ms", "asig/pet", "arena/pet", "errores");
+
+	bench_run("/nexu-info", port, "GET /nexu-info HTTP/1.1\r\n"
+		"Host: localhost\r\n\r\n", NULL, clients, requests);
+
+	const char *algorithms[][2] = {
+		{ "RSA", "/rest/sign RSA" },
+		{ "EC", "/rest/sign ECDSA" }
+	};
+	std::string certificates = bench_post("/rest/certificates", "{}");
+	for (std::size_t i = 0; i < 2; i++) {
+		prompt.choose(algorithms[i][0]);
+
+		if (i == 0) {
+			bench_run("/rest/certificates", port, certificates,
+				"\"success\":true", clients, requests);
+		}
+
+		BenchClient client(port);
+		std::string body;
+		client.send(certificates, body);
+		std::string id = bench_field(body, "id");
+		std::string key = bench_field(body, "keyId");
+		if (id.empty() || key.empty()) {
+			printf("%-24s sin certificado %s\n", algorithms[i][1],
+				algorithms[i][0]);
+			continue;
+		}
+
+		bench_run(algorithms[i][1], port, bench_post("/rest/sign",
+			"{\"tokenId\":{\"id\":\"" + id + "\"},"
+			"\"keyId\":\"" + key + "\","
+			"\"toBeSigned\":{\"bytes\":\""
+			FIRMADOR_BENCH_DIGEST "\"},"
+			"\"digestAlgorithm\":\"SHA256\"}"),
+			"\"success\":true", clients, requests);
+	}
+
+	service_stop();
+
+	return 0;
+}
@@ -0,0 +1,56 @@
+#!/bin/sh
+# Ejecuta un banco de pruebas contra un token de SoftHSM2 temporal:
+#
+#     bench/softhsm.sh ./bench/http -c 8 -n 500
+#
+# El propio programa genera en el token las claves y certificados RSA y ECDSA.
+# Sin SoftHSM2 instalado se omite sin dar error. SOFTHSM2_MODULE indica la
+# biblioteca si no está en una de las rutas habituales.
+
+set -e
+
+module=$SOFTHSM2_MODULE
+if test -z "$module"; then
+	for candidate in \
+		/usr/lib/softhsm/libsofthsm2.so \
+		/usr/lib/x86_64-linux-gnu/softhsm/libsofthsm2.so \
+		/usr/lib/aarch64-linux-gnu/softhsm/libsofthsm2.so \
+		/usr/lib64/pkcs11/libsofthsm2.so \
+		/usr/lib64/softhsm/libsofthsm2.so \
+		/usr/local/lib/softhsm/libsofthsm2.so \
+		/opt/homebrew/lib/softhsm/libsofthsm2.so; do
+		if test -f "$candidate"; then
+			module=$candidate
+			break
+		fi
+	done
+fi
+
+if test -z "$module" || ! command -v softhsm2-util >/dev/null 2>&1; then
+	echo "SoftHSM2 no está instalado, se omite $1." >&2
+	exit 0
+fi
+
+directory=$(mktemp -d)
+trap 'rm -rf "$directory"' EXIT INT TERM
+
+mkdir "$directory/tokens"
+cat > "$directory/softhsm2.conf" <<CONF
+directories.tokendir = $directory/tokens
+objectstore.backend = file
+log.level = ERROR
+CONF
+
+SOFTHSM2_CONF=$directory/softhsm2.conf
+FIRMADOR_PROVIDER=$module
+FIRMADOR_BENCH_TOKEN="pkcs11:token=firmador-bench"
+FIRMADOR_BENCH_PIN=${FIRMADOR_BENCH_PIN:-1234}
+FIRMADOR_HEADLESS=1
+FIRMADOR_PROMPT=console
+export SOFTHSM2_CONF FIRMADOR_PROVIDER FIRMADOR_BENCH_TOKEN \
+	FIRMADOR_BENCH_PIN FIRMADOR_HEADLESS FIRMADOR_PROMPT
+
+softhsm2-util --init-token --free --label firmador-bench \
+	--pin "$FIRMADOR_BENCH_PIN" --so-pin 12345678 >/dev/null
+
+"$@"
@@ -0,0 +1,98 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/*
+ * Microbenchmark de los generadores de UUID: llamadas por segundo con uno y
+ * varios hilos, para comprobar que no hay contención entre ellos.
+ */
+
+#include "uuid.h"
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#define FIRMADOR_BENCH_CALLS 1000000
+
+static int bench_v4(char *out) {
+	return uuid_v4(out);
+}
+
+static int bench_v7(char *out) {
+	return uuid_v7(out);
+}
+
+static int bench_string(char *out) {
+	std::string id = uuid();
+	out[0] = id[0];
+
+	return id.empty() ? -1 : 0;
+}
+
+static void bench_run(const char *name, int (*generator)(char *),
+	unsigned int threads) {
+
+	std::vector<std::thread> workers;
+	std::chrono::steady_clock::time_point start =
+		std::chrono::steady_clock::now();
+
+	for (unsigned int i = 0; i < threads; i++) {
+		workers.push_back(std::thread([generator]() {
+			char out[FIRMADOR_UUID_SIZE];
+			for (int j = 0; j < FIRMADOR_BENCH_CALLS; j++) {
+				if (generator(out) < 0) {
+					fprintf(stderr, "Error al generar.\n");
+					return;
+				}
+			}
+		}));
+	}
+	for (std::size_t i = 0; i < workers.size(); i++) {
+		workers.at(i).join();
+	}
+
+	double seconds = std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - start).count();
+	double calls = (double) FIRMADOR_BENCH_CALLS * threads;
+	printf("%-12s %2u hilos %12.0f llamadas/s %8.1f ns/llamada\n", name,
+		threads, calls / seconds, seconds * 1e9 / calls * threads);
+}
+
+int main() {
+	unsigned int threads = std::thread::hardware_concurrency();
+	if (threads == 0) {
+		threads = 4;
+	}
+
+	char out[FIRMADOR_UUID_SIZE];
+	uuid_v4(out);
+	printf("v4: %.*s\n", FIRMADOR_UUID_SIZE, out);
+	uuid_v7(out);
+	printf("v7: %.*s\n", FIRMADOR_UUID_SIZE, out);
+
+	bench_run("uuid_v4", &bench_v4, 1);
+	bench_run("uuid_v4", &bench_v4, threads);
+	bench_run("uuid_v7", &bench_v7, 1);
+	bench_run("uuid_v7", &bench_v7, threads);
+	bench_run("uuid", &bench_string, 1);
+	bench_run("uuid", &bench_string, threads);
+
+	return 0;
+}
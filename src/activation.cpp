@@ -0,0 +1,73 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "activation.h"
+
+#include <cstdlib>
+
+#ifndef _WIN32
+# include <fcntl.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+/*
+ * Con activación por socket systemd abre el puerto y arranca el firmador en la
+ * primera conexión, pasándole el socket ya a la escucha como descriptor 3 y
+ * anunciándolo en LISTEN_PID y LISTEN_FDS. Se usa solo el primero. Las
+ * variables se borran para que no las hereden procesos hijos como pinentry.
+ * Devuelve -1 si el servicio no se ha activado así.
+ */
+int activation_socket() {
+#ifdef _WIN32
+	return -1;
+#else
+	const char *pid = getenv("LISTEN_PID");
+	const char *fds = getenv("LISTEN_FDS");
+	if (pid == NULL || fds == NULL) {
+		return -1;
+	}
+
+	char *end;
+	unsigned long listen_pid = strtoul(pid, &end, 10);
+	bool own = *end == 0 && listen_pid == (unsigned long) getpid();
+	unsigned long listen_fds = strtoul(fds, &end, 10);
+	bool valid = *end == 0 && listen_fds > 0;
+
+	unsetenv("LISTEN_PID");
+	unsetenv("LISTEN_FDS");
+	unsetenv("LISTEN_FDNAMES");
+
+	if (!own || !valid) {
+		return -1;
+	}
+
+	int fd = FIRMADOR_ACTIVATION_FD;
+	struct stat status;
+	if (fstat(fd, &status) != 0 || !S_ISSOCK(status.st_mode)) {
+		return -1;
+	}
+
+	for (unsigned long i = 0; i < listen_fds; i++) {
+		fcntl(fd + i, F_SETFD, FD_CLOEXEC);
+	}
+
+	return fd;
+#endif
+}
@@ -0,0 +1,61 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "arena.h"
+
+#include <atomic>
+#include <cstdlib>
+
+/* Sin estado, así que todas las arenas comparten el mismo. */
+static ArenaBase arena_base;
+static std::atomic<unsigned long> arena_allocations(0);
+
+void *ArenaBase::Malloc(std::size_t size) {
+	if (size == 0) {
+		return NULL;
+	}
+	arena_allocations.fetch_add(1, std::memory_order_relaxed);
+
+	return std::malloc(size);
+}
+
+void *ArenaBase::Realloc(void *original, std::size_t original_size,
+	std::size_t size) {
+
+	(void) original_size;
+	if (size == 0) {
+		std::free(original);
+		return NULL;
+	}
+	arena_allocations.fetch_add(1, std::memory_order_relaxed);
+
+	return std::realloc(original, size);
+}
+
+void ArenaBase::Free(void *memory) {
+	std::free(memory);
+}
+
+unsigned long arena_chunks() {
+	return arena_allocations.load(std::memory_order_relaxed);
+}
+
+Arena::Arena() :
+	pool(buffer, sizeof(buffer), FIRMADOR_ARENA_CHUNK, &arena_base) {
+}
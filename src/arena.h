@@ -0,0 +1,82 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef FIRMADOR_ARENA_H
+#define FIRMADOR_ARENA_H
+
+#include <cstddef>
+
+#include "rapidjson/allocators.h"
+
+/*
+ * Bytes dentro del propio objeto y de cada bloque que se pide después. La
+ * respuesta de /rest/certificates o /rest/sign lleva la cadena de Firma
+ * Digital (10757 bytes en base64) y dos veces el certificado (unos 3 KB en
+ * base64 cada vez), algo más de 17 KB. El búfer de RapidJSON crece de 1,5 en
+ * 1,5 desde 256 bytes hasta 22145, que con la pila del escritor caben en
+ * 24 KiB. Cadenas más largas, como las de otras jerarquías, o los lotes de
+ * firmas piden bloques al sistema.
+ */
+#define FIRMADOR_ARENA_SIZE 24576
+#define FIRMADOR_ARENA_CHUNK 16384
+
+/*
+ * Origen de los bloques que no caben en el objeto: malloc, como el
+ * CrtAllocator de RapidJSON, pero contando cada bloque para arena_chunks().
+ */
+class ArenaBase {
+public:
+	static const bool kNeedFree = true;
+
+	void *Malloc(std::size_t size);
+	void *Realloc(void *original, std::size_t original_size,
+		std::size_t size);
+	static void Free(void *memory);
+
+	bool operator==(const ArenaBase &) const { return true; }
+	bool operator!=(const ArenaBase &) const { return false; }
+};
+
+typedef rapidjson::MemoryPoolAllocator<ArenaBase> arena_allocator_t;
+
+/* Bloques pedidos al sistema por todas las arenas desde el arranque. */
+unsigned long arena_chunks();
+
+/*
+ * Memoria de una petición HTTP, que se reparte avanzando un puntero y se
+ * libera de una vez al destruir la arena con la petición. Los primeros
+ * FIRMADOR_ARENA_SIZE bytes están en el propio objeto; con la cadena de
+ * Firma Digital y un certificado de hasta 4 KB la respuesta no pide memoria
+ * al sistema.
+ */
+class Arena {
+public:
+	Arena();
+
+	arena_allocator_t &allocator() { return pool; }
+
+private:
+	Arena(const Arena &);
+	Arena &operator=(const Arena &);
+
+	alignas(16) char buffer[FIRMADOR_ARENA_SIZE];
+	arena_allocator_t pool;
+};
+
+#endif
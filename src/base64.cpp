@@ -19,27 +19,404 @@ along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
 
 #include "base64.h"
 
-#include <vector>
-
-std::string base64_decode(const std::string &in) {
-	std::string out;
-	std::vector<int> vec(256, -1);
-
-	for (int i = 0; i < 64; i++) {
-		vec[
-			"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdef"
-			"ghijklmnopqrstuvwxyz0123456789+/"[i]] = i;
-	}
-	int val = 0, valb = -8;
-	for (unsigned c = 0; c < in.size(); ++c) {
-		if (vec[in[c]] == -1) break;
-		val = (val << 6) + vec[in[c]];
-		valb += 6;
-		if (valb >= 0) {
-			out.push_back(char((val >> valb) & 0xFF));
-			valb -= 8;
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+# define FIRMADOR_BASE64_X86
+# include <immintrin.h>
+#endif
+
+static constexpr char base64_alphabet[] =
+	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static constexpr signed char base64_values[256] = {
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 62, -1, -1, -1, 63,
+	52, 53, 54, 55, 56, 57, 58, 59, 60, 61, -1, -1, -1, -1, -1, -1,
+	-1, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14,
+	15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, -1,
+	-1, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+	41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+};
+
+/*
+ * Los núcleos vectoriales procesan bloques completos y devuelven cuántos
+ * bytes de entrada han consumido; el resto, incluido el relleno y cualquier
+ * bloque con caracteres no válidos, lo termina el código escalar.
+ */
+typedef std::size_t (*base64_kernel_t)(const unsigned char *in,
+	std::size_t size, unsigned char *out);
+
+#ifdef FIRMADOR_BASE64_X86
+/* Índices de 6 bits a caracteres: una resta saturada y una tabla pshufb. */
+__attribute__((target("ssse3")))
+static inline __m128i base64_ssse3_characters(__m128i indices) {
+	const __m128i shift = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52,
+		'0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+		'0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+
+	__m128i result = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+	__m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+	result = _mm_or_si128(result, _mm_and_si128(less, _mm_set1_epi8(13)));
+
+	return _mm_add_epi8(_mm_shuffle_epi8(shift, result), indices);
+}
+
+/* Reparte 12 bytes en 16 índices de 6 bits, uno por byte. */
+__attribute__((target("ssse3")))
+static inline __m128i base64_ssse3_indices(__m128i in) {
+	in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4,
+		5, 3, 4, 1, 2, 0, 1));
+
+	__m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+	__m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+	__m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+	__m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+
+	return _mm_or_si128(t1, t3);
+}
+
+__attribute__((target("ssse3")))
+static std::size_t base64_encode_ssse3(const unsigned char *in,
+	std::size_t size, unsigned char *out) {
+
+	std::size_t i = 0;
+
+	/* Se leen 16 bytes para usar 12. */
+	for (; size - i >= 16; i += 12, out += 16) {
+		__m128i block = _mm_loadu_si128((const __m128i*)(in + i));
+		_mm_storeu_si128((__m128i*)out,
+			base64_ssse3_characters(base64_ssse3_indices(block)));
+	}
+
+	return i;
+}
+
+/*
+ * Traduce 16 caracteres a valores de 6 bits. Las tablas por nibble marcan
+ * los caracteres fuera del alfabeto; invalid recibe la máscara de error.
+ */
+__attribute__((target("ssse3")))
+static inline __m128i base64_ssse3_values(__m128i in, int &invalid) {
+	const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11,
+		0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B,
+		0x1A);
+	const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04,
+		0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+		0x10);
+	const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71,
+		-71, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m128i nibble = _mm_set1_epi8(0x0f);
+
+	__m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(in, 4), nibble);
+	__m128i lo_nibbles = _mm_and_si128(in, nibble);
+	__m128i lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+	__m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+
+	invalid = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lo, hi),
+		_mm_setzero_si128())) ^ 0xFFFF;
+
+	__m128i slash = _mm_cmpeq_epi8(in, _mm_set1_epi8(0x2F));
+	__m128i roll = _mm_shuffle_epi8(lut_roll,
+		_mm_add_epi8(slash, hi_nibbles));
+
+	return _mm_add_epi8(in, roll);
+}
+
+/* Junta 16 valores de 6 bits en 12 bytes al principio del registro. */
+__attribute__((target("ssse3")))
+static inline __m128i base64_ssse3_pack(__m128i values) {
+	__m128i merged = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+	merged = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+
+	return _mm_shuffle_epi8(merged, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10,
+		9, 8, 14, 13, 12, -1, -1, -1, -1));
+}
+
+__attribute__((target("ssse3")))
+static std::size_t base64_decode_ssse3(const unsigned char *in,
+	std::size_t size, unsigned char *out) {
+
+	std::size_t i = 0;
+	unsigned char block[16];
+
+	/* El último cuarteto, que puede llevar relleno, queda al escalar. */
+	for (; size - i > 16; i += 16, out += 12) {
+		int invalid;
+		__m128i values = base64_ssse3_values(
+			_mm_loadu_si128((const __m128i*)(in + i)), invalid);
+		if (invalid != 0) {
+			break;
+		}
+		_mm_storeu_si128((__m128i*)block, base64_ssse3_pack(values));
+		memcpy(out, block, 12);
+	}
+
+	return i;
+}
+
+/* Las mismas operaciones que SSSE3, en los dos carriles de 128 bits. */
+__attribute__((target("avx2")))
+static std::size_t base64_encode_avx2(const unsigned char *in,
+	std::size_t size, unsigned char *out) {
+
+	const __m256i shuffle = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7,
+		6, 8, 7, 10, 9, 11, 10, 1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10,
+		9, 11, 10);
+	const __m256i shift = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52,
+		'0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+		'0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0, 'a' - 26,
+		'0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+		'0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A',
+		0, 0);
+	std::size_t i = 0;
+
+	/* Cada carril lee 16 bytes para usar 12. */
+	for (; size - i >= 28; i += 24, out += 32) {
+		__m256i block = _mm256_inserti128_si256(_mm256_castsi128_si256(
+			_mm_loadu_si128((const __m128i*)(in + i))),
+			_mm_loadu_si128((const __m128i*)(in + i + 12)), 1);
+		block = _mm256_shuffle_epi8(block, shuffle);
+
+		__m256i t0 = _mm256_and_si256(block,
+			_mm256_set1_epi32(0x0fc0fc00));
+		__m256i t1 = _mm256_mulhi_epu16(t0,
+			_mm256_set1_epi32(0x04000040));
+		__m256i t2 = _mm256_and_si256(block,
+			_mm256_set1_epi32(0x003f03f0));
+		__m256i t3 = _mm256_mullo_epi16(t2,
+			_mm256_set1_epi32(0x01000010));
+		__m256i indices = _mm256_or_si256(t1, t3);
+
+		__m256i result = _mm256_subs_epu8(indices,
+			_mm256_set1_epi8(51));
+		__m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26),
+			indices);
+		result = _mm256_or_si256(result, _mm256_and_si256(less,
+			_mm256_set1_epi8(13)));
+		result = _mm256_add_epi8(_mm256_shuffle_epi8(shift, result),
+			indices);
+
+		_mm256_storeu_si256((__m256i*)out, result);
+	}
+
+	return i + base64_encode_ssse3(in + i, size - i, out);
+}
+
+__attribute__((target("avx2")))
+static std::size_t base64_decode_avx2(const unsigned char *in,
+	std::size_t size, unsigned char *out) {
+
+	const __m256i lut_lo = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11,
+		0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B,
+		0x1A, 0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+		0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+	const __m256i lut_hi = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04,
+		0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+		0x10, 0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10,
+		0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m256i lut_roll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65,
+		-71, -71, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 19, 4, -65, -65, -71,
+		-71, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m256i pack = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8,
+		14, 13, 12, -1, -1, -1, -1, 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13,
+		12, -1, -1, -1, -1);
+	const __m256i nibble = _mm256_set1_epi8(0x0f);
+	std::size_t i = 0;
+	unsigned char block[32];
+
+	for (; size - i > 32; i += 32, out += 24) {
+		__m256i chars = _mm256_loadu_si256((const __m256i*)(in + i));
+		__m256i hi_nibbles = _mm256_and_si256(
+			_mm256_srli_epi32(chars, 4), nibble);
+		__m256i lo_nibbles = _mm256_and_si256(chars, nibble);
+		__m256i lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+		__m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+		if (!_mm256_testz_si256(lo, hi)) {
+			break;
 		}
+
+		__m256i slash = _mm256_cmpeq_epi8(chars,
+			_mm256_set1_epi8(0x2F));
+		__m256i roll = _mm256_shuffle_epi8(lut_roll,
+			_mm256_add_epi8(slash, hi_nibbles));
+		__m256i values = _mm256_add_epi8(chars, roll);
+
+		values = _mm256_maddubs_epi16(values,
+			_mm256_set1_epi32(0x01400140));
+		values = _mm256_madd_epi16(values,
+			_mm256_set1_epi32(0x00011000));
+		values = _mm256_shuffle_epi8(values, pack);
+
+		_mm256_storeu_si256((__m256i*)block, values);
+		memcpy(out, block, 12);
+		memcpy(out + 12, block + 16, 12);
+	}
+
+	return i + base64_decode_ssse3(in + i, size - i, out);
+}
+#endif
+
+struct base64_kernels_t {
+	base64_kernel_t encode;
+	base64_kernel_t decode;
+};
+
+static base64_kernels_t base64_kernels_detect() {
+	base64_kernels_t kernels = {NULL, NULL};
+
+#ifdef FIRMADOR_BASE64_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		kernels.encode = &base64_encode_avx2;
+		kernels.decode = &base64_decode_avx2;
+	} else if (__builtin_cpu_supports("ssse3")) {
+		kernels.encode = &base64_encode_ssse3;
+		kernels.decode = &base64_decode_ssse3;
+	}
+#endif
+
+	return kernels;
+}
+
+/* Se elige la implementación una vez, según la CPU en ejecución. */
+static base64_kernels_t &base64_kernels() {
+	static base64_kernels_t kernels = base64_kernels_detect();
+
+	return kernels;
+}
+
+bool base64_select(const char *name) {
+	base64_kernels_t kernels = {NULL, NULL};
+
+	if (strcmp(name, "scalar") == 0) {
+		base64_kernels() = kernels;
+		return true;
+	}
+
+#ifdef FIRMADOR_BASE64_X86
+	__builtin_cpu_init();
+	if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+		kernels.encode = &base64_encode_avx2;
+		kernels.decode = &base64_decode_avx2;
+	} else if (strcmp(name, "ssse3") == 0
+		&& __builtin_cpu_supports("ssse3")) {
+		kernels.encode = &base64_encode_ssse3;
+		kernels.decode = &base64_decode_ssse3;
+	}
+#endif
+	if (kernels.encode == NULL) {
+		return false;
+	}
+	base64_kernels() = kernels;
+
+	return true;
+}
+
+std::string base64_encode(const unsigned char *data, std::size_t size) {
+	std::string out((size + 2) / 3 * 4, 0);
+	if (size == 0) {
+		return out;
+	}
+	unsigned char *dst = (unsigned char*)&out[0];
+
+	std::size_t i = 0;
+	base64_kernel_t kernel = base64_kernels().encode;
+	if (kernel != NULL) {
+		i = kernel(data, size, dst);
+		dst += i / 3 * 4;
+	}
+
+	for (; size - i >= 3; i += 3, dst += 4) {
+		unsigned int block = data[i] << 16 | data[i + 1] << 8
+			| data[i + 2];
+		dst[0] = base64_alphabet[block >> 18];
+		dst[1] = base64_alphabet[block >> 12 & 0x3F];
+		dst[2] = base64_alphabet[block >> 6 & 0x3F];
+		dst[3] = base64_alphabet[block & 0x3F];
+	}
+
+	if (size - i == 1) {
+		dst[0] = base64_alphabet[data[i] >> 2];
+		dst[1] = base64_alphabet[(data[i] & 0x03) << 4];
+		dst[2] = '=';
+		dst[3] = '=';
+	} else if (size - i == 2) {
+		dst[0] = base64_alphabet[data[i] >> 2];
+		dst[1] = base64_alphabet[(data[i] & 0x03) << 4
+			| data[i + 1] >> 4];
+		dst[2] = base64_alphabet[(data[i + 1] & 0x0F) << 2];
+		dst[3] = '=';
 	}
 
 	return out;
 }
+
+bool base64_decode(const char *data, std::size_t size, std::string &out) {
+	const unsigned char *in = (const unsigned char*)data;
+
+	out.clear();
+	if (size % 4 != 0) {
+		return false;
+	}
+	if (size == 0) {
+		return true;
+	}
+
+	std::size_t padding = in[size - 1] != '=' ? 0
+		: in[size - 2] != '=' ? 1 : 2;
+	out.resize(size / 4 * 3 - padding);
+	unsigned char *dst = (unsigned char*)&out[0];
+
+	std::size_t i = 0;
+	base64_kernel_t kernel = base64_kernels().decode;
+	if (kernel != NULL) {
+		i = kernel(in, size, dst);
+		dst += i / 4 * 3;
+	}
+
+	for (; i < size - 4; i += 4, dst += 3) {
+		int a = base64_values[in[i]];
+		int b = base64_values[in[i + 1]];
+		int c = base64_values[in[i + 2]];
+		int d = base64_values[in[i + 3]];
+		if ((a | b | c | d) < 0) {
+			out.clear();
+			return false;
+		}
+		unsigned int block = a << 18 | b << 12 | c << 6 | d;
+		dst[0] = block >> 16;
+		dst[1] = block >> 8;
+		dst[2] = block;
+	}
+
+	/* Último cuarteto: relleno y bits sobrantes a cero. */
+	int a = base64_values[in[i]];
+	int b = base64_values[in[i + 1]];
+	int c = padding < 2 ? base64_values[in[i + 2]] : 0;
+	int d = padding < 1 ? base64_values[in[i + 3]] : 0;
+	if ((a | b | c | d) < 0 || (padding == 2 && (b & 0x0F) != 0)
+		|| (padding == 1 && (c & 0x03) != 0)) {
+		out.clear();
+		return false;
+	}
+	unsigned int block = a << 18 | b << 12 | c << 6 | d;
+	dst[0] = block >> 16;
+	if (padding < 2) {
+		dst[1] = block >> 8;
+	}
+	if (padding < 1) {
+		dst[2] = block;
+	}
+
+	return true;
+}
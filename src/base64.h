@@ -20,8 +20,26 @@ along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
 #ifndef FIRMADOR_BASE64_H
 #define FIRMADOR_BASE64_H
 
+#include <cstddef>
 #include <string>
 
-std::string base64_decode(const std::string &in);
+/*
+ * Base64 estándar con relleno, sin saltos de línea. Trabajan sobre puntero y
+ * longitud para no copiar los datos de origen y reservan la salida exacta.
+ */
+std::string base64_encode(const unsigned char *data, std::size_t size);
+
+/*
+ * Devuelve false si la entrada no es base64 canónico: longitud que no es
+ * múltiplo de 4, caracteres fuera del alfabeto, relleno fuera del final o
+ * bits sobrantes distintos de cero. En ese caso out queda vacío.
+ */
+bool base64_decode(const char *data, std::size_t size, std::string &out);
+
+/*
+ * Fuerza la implementación "avx2", "ssse3" o "scalar" en lugar de la que se
+ * elige según la CPU, para las pruebas. Devuelve false si no está disponible.
+ */
+bool base64_select(const char *name);
 
 #endif
@@ -0,0 +1,146 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "body.h"
+#include "base64.h"
+
+SignRequestParser::SignRequestParser(sign_request_t &request) :
+	request(request), reader(*this), elements(0) {
+}
+
+bool SignRequestParser::feed(const char *data, std::size_t size) {
+	return reader.feed(data, size);
+}
+
+/* Cada elemento de toBeSigned debe haber aportado exactamente un bytes. */
+bool SignRequestParser::finish() {
+	return reader.finish() && (!request.batch
+		|| elements == request.to_be_signed.size());
+}
+
+/* Comprueba si la ruta hasta el valor actual es exactamente la indicada. */
+bool SignRequestParser::at(const char *first, const char *second,
+	const char *third) const {
+
+	const char *names[] = {first, second, third};
+	std::size_t size = third != NULL ? 3 : second != NULL ? 2 : 1;
+
+	if (path.size() != size) {
+		return false;
+	}
+	for (std::size_t i = 0; i < size; i++) {
+		if (path.at(i) != names[i]) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/* Valores que deberían ser el objeto con bytes y son de otro tipo. */
+bool SignRequestParser::document() const {
+	return at("toBeSigned") || at("toBeSigned", "[]")
+		|| at("toBeSigned", "bytes")
+		|| at("toBeSigned", "[]", "bytes");
+}
+
+/* Campos que se leen como cadenas y no admiten otro tipo de valor. */
+bool SignRequestParser::text() const {
+	return at("keyId") || at("digestAlgorithm") || at("tokenId", "id");
+}
+
+bool SignRequestParser::StartObject() {
+	if (at("toBeSigned", "[]")) {
+		elements++;
+	} else if (text() || (!at("toBeSigned") && document())) {
+		return false;
+	}
+	path.push_back(std::string());
+
+	return true;
+}
+
+bool SignRequestParser::EndObject() {
+	path.pop_back();
+
+	return true;
+}
+
+bool SignRequestParser::StartArray() {
+	if (path.empty()) {
+		return false;
+	}
+	if (at("toBeSigned")) {
+		request.batch = true;
+		request.to_be_signed.reserve(16);
+	} else if (text() || document()) {
+		return false;
+	}
+	path.push_back("[]");
+
+	return true;
+}
+
+bool SignRequestParser::EndArray() {
+	path.pop_back();
+
+	return true;
+}
+
+bool SignRequestParser::Key(const char *str, std::size_t length) {
+	path.back().assign(str, length);
+
+	return true;
+}
+
+bool SignRequestParser::String(const char *str, std::size_t length) {
+	if (path.empty()) {
+		return false;
+	}
+
+	if (at("keyId")) {
+		request.key_id.assign(str, length);
+	} else if (at("digestAlgorithm")) {
+		request.digest_algorithm.assign(str, length);
+	} else if (at("tokenId", "id")) {
+		request.token_id.assign(str, length);
+	} else if (at("toBeSigned", "bytes")
+		|| at("toBeSigned", "[]", "bytes")) {
+		if (request.to_be_signed.size() >= FIRMADOR_SIGN_BATCH_MAX) {
+			request.overflow = true;
+			return false;
+		}
+		request.to_be_signed.push_back(std::string());
+		if (!base64_decode(str, length,
+			request.to_be_signed.back())) {
+			return false;
+		}
+	} else if (document()) {
+		return false;
+	}
+
+	return true;
+}
+
+bool SignRequestParser::Scalar(const char *str, std::size_t length) {
+	(void)str;
+	(void)length;
+
+	return !path.empty() && !text() && !document();
+}
@@ -0,0 +1,82 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef FIRMADOR_BODY_H
+#define FIRMADOR_BODY_H
+
+#include "json.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/* Documentos que admite como máximo una petición a /rest/sign/batch. */
+#define FIRMADOR_SIGN_BATCH_MAX 1000
+
+/* Campos de una petición de firma, ya decodificados de base64. */
+struct sign_request_t {
+	std::string token_id;
+	std::string key_id;
+	std::string digest_algorithm;
+	std::vector<std::string> to_be_signed;
+	/* toBeSigned era un arreglo, como en /rest/sign/batch. */
+	bool batch;
+	/* Había más documentos que FIRMADOR_SIGN_BATCH_MAX. */
+	bool overflow;
+	/* toBeSigned es el resumen del cuerpo, como en /rest/sign/stream. */
+	bool hashed;
+
+	sign_request_t() : batch(false), overflow(false), hashed(false) {}
+};
+
+/*
+ * Decodifica el cuerpo de /rest/sign y /rest/sign/batch a medida que llega,
+ * guardando solo los campos conocidos. Los demás se descartan sin
+ * construir ningún árbol del documento.
+ */
+class SignRequestParser : private JsonHandler {
+public:
+	explicit SignRequestParser(sign_request_t &request);
+
+	bool feed(const char *data, std::size_t size);
+	bool finish();
+
+private:
+	virtual bool StartObject();
+	virtual bool EndObject();
+	virtual bool StartArray();
+	virtual bool EndArray();
+	virtual bool Key(const char *str, std::size_t length);
+	virtual bool String(const char *str, std::size_t length);
+	virtual bool Scalar(const char *str, std::size_t length);
+
+	bool at(const char *first, const char *second = NULL,
+		const char *third = NULL) const;
+	bool document() const;
+	bool text() const;
+
+	sign_request_t &request;
+	JsonReader reader;
+	/* Clave actual de cada objeto abierto, "[]" para los arreglos. */
+	std::vector<std::string> path;
+	/* Objetos abiertos dentro del arreglo toBeSigned. */
+	std::size_t elements;
+};
+
+#endif
@@ -0,0 +1,329 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "cache.h"
+#include "config.h"
+#include "metrics.h"
+#include "monitor.h"
+#include "provider.h"
+#include "token.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include <gnutls/pkcs11.h>
+
+/*
+ * Índice de certificados por número de serie del token y por URL del objeto.
+ * Cada actualización publica un índice nuevo e inmutable que comparte los
+ * tokens sin cambios con el anterior, de modo que solamente se leen de la
+ * tarjeta los tokens recién insertados.
+ */
+typedef std::map<std::string, certificate_t> cache_objects_t;
+typedef std::map<std::string, std::shared_ptr<const cache_objects_t> >
+	cache_tokens_t;
+
+/*
+ * Los lectores (las peticiones HTTP) no toman ningún cerrojo: anuncian que
+ * están leyendo, copian del índice actual y terminan. Quien publica un índice
+ * nuevo espera a que no quede ningún lector antes de liberar el anterior.
+ */
+static std::atomic<const cache_tokens_t *> cache_index(NULL);
+static std::atomic<unsigned int> cache_readers(0);
+static std::mutex cache_writer_mutex;
+
+static std::atomic<bool> cache_ready(false);
+static std::mutex cache_ready_mutex;
+static std::condition_variable cache_ready_condition;
+
+static MetricCounter cache_hits("firmador_cache_hits_total", "",
+	"Listados de certificados servidos desde el índice.");
+static MetricCounter cache_reads("firmador_cache_token_reads_total", "",
+	"Tokens leídos de la tarjeta para el índice.");
+
+static void cache_publish(const cache_tokens_t *tokens) {
+	const cache_tokens_t *old = cache_index.exchange(tokens);
+
+	while (cache_readers.load() != 0) {
+		std::this_thread::yield();
+	}
+	delete old;
+
+	if (!cache_ready.load()) {
+		std::lock_guard<std::mutex> lock(cache_ready_mutex);
+		cache_ready = true;
+		cache_ready_condition.notify_all();
+	}
+}
+
+void cache_certificates(std::vector<certificate_t> &certificates) {
+	/*
+	 * Solamente espera hasta que termine la primera lectura de ranuras, que
+	 * empieza con la primera petición.
+	 */
+	if (!cache_ready.load()) {
+		monitor_request();
+		std::unique_lock<std::mutex> lock(cache_ready_mutex);
+		while (!cache_ready.load()) {
+			cache_ready_condition.wait(lock);
+		}
+	}
+
+	cache_readers++;
+	const cache_tokens_t *tokens = cache_index.load();
+	if (tokens != NULL) {
+		for (cache_tokens_t::const_iterator it = tokens->begin();
+			it != tokens->end(); ++it) {
+			for (cache_objects_t::const_iterator object =
+				it->second->begin();
+				object != it->second->end(); ++object) {
+				certificates.push_back(object->second);
+			}
+		}
+	}
+	cache_readers--;
+
+	cache_hits.add();
+}
+
+/* Lectura de un token recién insertado en su propio hilo. */
+struct cache_slot_t {
+	std::string url;
+	std::string serial;
+	bool done;
+	int ret;
+	std::vector<certificate_t> certificates;
+};
+
+/*
+ * Estado compartido entre cache_update y los hilos de lectura. Un lector que
+ * excede el tiempo sigue vivo cuando cache_update ya ha terminado, por eso se
+ * comparte con shared_ptr y los hilos no se esperan.
+ */
+struct cache_batch_t {
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::vector<cache_slot_t> slots;
+};
+
+/*
+ * Tokens con una lectura en curso. Un lector colgado deja su token aquí hasta
+ * que termine, para no lanzar otro sobre el mismo lector.
+ */
+static std::set<std::string> cache_busy;
+static std::mutex cache_busy_mutex;
+
+static void cache_read(std::shared_ptr<cache_batch_t> batch,
+	std::size_t index) {
+
+	const std::string url = batch->slots.at(index).url;
+	const std::string serial = batch->slots.at(index).serial;
+	std::vector<certificate_t> certificates;
+
+	int ret = token_read(url, certificates);
+	cache_reads.add();
+	for (std::size_t i = 0; i < certificates.size(); i++) {
+		certificates.at(i).serial = serial;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(batch->mutex);
+		cache_slot_t &slot = batch->slots.at(index);
+		slot.certificates.swap(certificates);
+		slot.ret = ret;
+		slot.done = true;
+	}
+	batch->condition.notify_all();
+
+	{
+		std::lock_guard<std::mutex> lock(cache_busy_mutex);
+		cache_busy.erase(serial);
+	}
+	provider_release();
+}
+
+/*
+ * Lista las ranuras, lo que no lee objetos de la tarjeta, y compara con el
+ * índice actual para leer únicamente los tokens insertados y descartar los
+ * retirados, cuyos números de serie se devuelven en removed. Los tokens
+ * nuevos se leen a la vez, uno por hilo, y cada uno se publica en cuanto
+ * termina. Los que no terminan en FIRMADOR_SLOT_TIMEOUT se dejan para una
+ * actualización posterior sin retrasar a los demás. Si no hay cambios no se
+ * publica nada.
+ */
+int cache_update(std::size_t &inserted, std::vector<std::string> &removed) {
+	inserted = 0;
+	removed.clear();
+
+	std::vector<std::string> urls;
+	int ret = provider_loaded() ? token_urls(urls)
+		: GNUTLS_E_PKCS11_LOAD_ERROR;
+
+	std::lock_guard<std::mutex> lock(cache_writer_mutex);
+
+	if (ret < GNUTLS_E_SUCCESS) {
+		/* Que las peticiones no esperen indefinidamente al índice. */
+		if (cache_index.load() == NULL) {
+			cache_publish(new cache_tokens_t());
+		}
+		return ret;
+	}
+
+	const cache_tokens_t *current = cache_index.load();
+	cache_tokens_t tokens;
+	std::shared_ptr<cache_batch_t> batch(new cache_batch_t());
+
+	std::set<std::string> present;
+	for (std::size_t i = 0; i < urls.size(); i++) {
+		std::string serial = token_serial(urls.at(i));
+		present.insert(serial);
+
+		if (current != NULL && current->count(serial) != 0) {
+			tokens[serial] = current->at(serial);
+			continue;
+		}
+
+		std::lock_guard<std::mutex> busy_lock(cache_busy_mutex);
+		if (!cache_busy.insert(serial).second) {
+			continue;
+		}
+
+		cache_slot_t slot;
+		slot.url = urls.at(i);
+		slot.serial = serial;
+		slot.done = false;
+		slot.ret = GNUTLS_E_SUCCESS;
+		batch->slots.push_back(slot);
+	}
+
+	if (current != NULL) {
+		for (cache_tokens_t::const_iterator it = current->begin();
+			it != current->end(); ++it) {
+			if (present.count(it->first) == 0) {
+				removed.push_back(it->first);
+			}
+		}
+	}
+
+	/* Los retirados desaparecen sin esperar a las lecturas. */
+	bool published = false;
+	if (current == NULL ? batch->slots.empty() : !removed.empty()) {
+		cache_publish(new cache_tokens_t(tokens));
+		published = true;
+	}
+
+	/* Los hilos no se esperan, pero sí retienen los módulos cargados. */
+	for (std::size_t i = 0; i < batch->slots.size(); i++) {
+		if (provider_hold()) {
+			std::thread(cache_read, batch, i).detach();
+			continue;
+		}
+
+		cache_slot_t &slot = batch->slots.at(i);
+		slot.ret = GNUTLS_E_PKCS11_LOAD_ERROR;
+		slot.done = true;
+		std::lock_guard<std::mutex> busy_lock(cache_busy_mutex);
+		cache_busy.erase(slot.serial);
+	}
+
+	std::chrono::steady_clock::time_point deadline =
+		std::chrono::steady_clock::now()
+		+ std::chrono::seconds(config().slot_timeout);
+	std::vector<bool> merged(batch->slots.size(), false);
+	std::size_t pending = batch->slots.size();
+
+	std::unique_lock<std::mutex> batch_lock(batch->mutex);
+	while (pending != 0) {
+		bool timeout = !batch->condition.wait_until(batch_lock,
+			deadline, [&batch, &merged]() {
+			for (std::size_t i = 0; i < merged.size(); i++) {
+				if (batch->slots.at(i).done && !merged.at(i)) {
+					return true;
+				}
+			}
+			return false;
+		});
+		if (timeout) {
+			break;
+		}
+
+		bool changed = false;
+		for (std::size_t i = 0; i < merged.size(); i++) {
+			cache_slot_t &slot = batch->slots.at(i);
+			if (!slot.done || merged.at(i)) {
+				continue;
+			}
+			merged.at(i) = true;
+			pending--;
+
+			/* Si falla se reintenta en la próxima actualización. */
+			if (slot.ret < GNUTLS_E_SUCCESS) {
+				continue;
+			}
+
+			std::shared_ptr<cache_objects_t> objects(
+				new cache_objects_t());
+			for (std::size_t j = 0; j < slot.certificates.size();
+				j++) {
+				(*objects)[slot.certificates.at(j).url] =
+					slot.certificates.at(j);
+			}
+			tokens[slot.serial] = objects;
+			inserted++;
+			changed = true;
+		}
+
+		if (changed) {
+			cache_publish(new cache_tokens_t(tokens));
+			published = true;
+		}
+	}
+	batch_lock.unlock();
+
+	if (current == NULL && !published) {
+		cache_publish(new cache_tokens_t(tokens));
+	}
+
+	return GNUTLS_E_SUCCESS;
+}
+
+void cache_invalidate(const std::string &serial) {
+	std::lock_guard<std::mutex> lock(cache_writer_mutex);
+
+	const cache_tokens_t *current = cache_index.load();
+	if (current == NULL || current->count(serial) == 0) {
+		return;
+	}
+
+	cache_tokens_t *tokens = new cache_tokens_t(*current);
+	tokens->erase(serial);
+	cache_publish(tokens);
+}
+
+void cache_clear() {
+	std::lock_guard<std::mutex> lock(cache_writer_mutex);
+
+	cache_publish(new cache_tokens_t());
+}
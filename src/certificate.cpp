@@ -0,0 +1,96 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "certificate.h"
+#include "base64.h"
+
+static const std::string certificate_empty;
+
+/* Huella SHA-256 del certificado en hexadecimal en mayúsculas. */
+const std::string &certificate_key_id(const certificate_t &certificate) {
+	if (!certificate.x509) {
+		return certificate_empty;
+	}
+
+	certificate_x509_t &x509 = *certificate.x509;
+	std::lock_guard<std::mutex> lock(x509.mutex);
+
+	if (x509.keyId.empty()) {
+		static constexpr char hex[] = "0123456789ABCDEF";
+		unsigned char fingerprint[32];
+		std::size_t fingerprint_size = sizeof(fingerprint);
+
+		if (gnutls_x509_crt_get_fingerprint(x509.crt, GNUTLS_DIG_SHA256,
+			fingerprint, &fingerprint_size) == GNUTLS_E_SUCCESS) {
+			x509.keyId.reserve(fingerprint_size * 2);
+			for (std::size_t i = 0; i < fingerprint_size; i++) {
+				x509.keyId += hex[fingerprint[i] >> 4];
+				x509.keyId += hex[fingerprint[i] & 0x0F];
+			}
+		}
+	}
+
+	return x509.keyId;
+}
+
+/* DER en base64 e identificador de la autoridad, que se usan juntos. */
+static certificate_x509_t *certificate_encode(
+	const certificate_t &certificate) {
+
+	if (!certificate.x509) {
+		return NULL;
+	}
+
+	certificate_x509_t &x509 = *certificate.x509;
+	std::lock_guard<std::mutex> lock(x509.mutex);
+
+	if (!x509.encoded) {
+		gnutls_datum_t cert_der;
+		if (gnutls_x509_crt_export2(x509.crt, GNUTLS_X509_FMT_DER,
+			&cert_der) == GNUTLS_E_SUCCESS) {
+			x509.certificate = base64_encode(cert_der.data,
+				cert_der.size);
+			gnutls_free(cert_der.data);
+		}
+
+		unsigned char authority[64];
+		std::size_t authority_size = sizeof(authority);
+		if (gnutls_x509_crt_get_authority_key_id(x509.crt, authority,
+			&authority_size, NULL) == GNUTLS_E_SUCCESS) {
+			x509.authority.assign((const char*)authority,
+				authority_size);
+		}
+
+		x509.encoded = true;
+	}
+
+	return &x509;
+}
+
+const std::string &certificate_der(const certificate_t &certificate) {
+	certificate_x509_t *x509 = certificate_encode(certificate);
+
+	return x509 != NULL ? x509->certificate : certificate_empty;
+}
+
+const std::string &certificate_authority(const certificate_t &certificate) {
+	certificate_x509_t *x509 = certificate_encode(certificate);
+
+	return x509 != NULL ? x509->authority : certificate_empty;
+}
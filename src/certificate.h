@@ -20,14 +20,45 @@ along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
 #ifndef FIRMADOR_CERTIFICATE_H
 #define FIRMADOR_CERTIFICATE_H
 
+#include <memory>
+#include <mutex>
 #include <string>
 
-struct certificate_t {
-	std::string id;
+#include <gnutls/x509.h>
+
+/*
+ * Certificado importado del token. Huella, DER en base64 e identificador de
+ * la autoridad se calculan solo cuando se piden, normalmente para el
+ * certificado elegido, y se guardan para las siguientes veces.
+ */
+struct certificate_x509_t {
+	gnutls_x509_crt_t crt;
+	std::mutex mutex;
 	std::string keyId;
 	std::string certificate;
-	std::string certificateChain;
+	std::string authority;
+	bool encoded;
+
+	explicit certificate_x509_t(gnutls_x509_crt_t crt) : crt(crt),
+		encoded(false) {}
+	~certificate_x509_t() { gnutls_x509_crt_deinit(crt); }
+};
+
+/*
+ * Lo que muestra el diálogo de selección se lee al listar; lo demás se obtiene
+ * de x509, compartido por todas las copias del certificado.
+ */
+struct certificate_t {
+	std::string id;
 	std::string encryptionAlgorithm;
+	std::string caption;
+	std::string url;
+	std::string serial;
+	std::shared_ptr<certificate_x509_t> x509;
 };
 
+const std::string &certificate_key_id(const certificate_t &certificate);
+const std::string &certificate_der(const certificate_t &certificate);
+const std::string &certificate_authority(const certificate_t &certificate);
+
 #endif
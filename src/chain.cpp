@@ -0,0 +1,397 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "chain.h"
+#include "base64.h"
+#include "file.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+#include <gnutls/x509.h>
+
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+
+/*
+ * Cadena de Firma Digital de Costa Rica para persona física v2, desde la CA
+ * emisora hasta la raíz, en DER codificado en base64. Siempre se carga; otras
+ * jerarquías se añaden con ficheros en el directorio de CA.
+ */
+static const char *const chain_certificates[] = {
+	// CA SINPE - PERSONA FISICA v2
+	"MIINADCCCuigAwIBAgITSwAAAAMTyepkVGDdawAAAAAAAzANBgkqhkiG9w0BAQ0F"
+	"ADB9MRkwFwYDVQQFExBDUEotMi0xMDAtMDk4MzExMQswCQYDVQQGEwJDUjEPMA0G"
+	"A1UEChMGTUlDSVRUMQ0wCwYDVQQLEwREQ0ZEMTMwMQYDVQQDEypDQSBQT0xJVElD"
+	"QSBQRVJTT05BIEZJU0lDQSAtIENPU1RBIFJJQ0EgdjIwHhcNMTYwMTIxMTgxNjA4"
+	"WhcNMjQwMTIxMTgyNjA4WjCBmTEZMBcGA1UEBRMQQ1BKLTQtMDAwLTAwNDAxNzEL"
+	"MAkGA1UEBhMCQ1IxJDAiBgNVBAoTG0JBTkNPIENFTlRSQUwgREUgQ09TVEEgUklD"
+	"QTEiMCAGA1UECxMZRElWSVNJT04gU0lTVEVNQVMgREUgUEFHTzElMCMGA1UEAxMc"
+	"Q0EgU0lOUEUgLSBQRVJTT05BIEZJU0lDQSB2MjCCASIwDQYJKoZIhvcNAQEBBQAD"
+	"ggEPADCCAQoCggEBAOa9ooS00UHFT099PwJl/OLq8TVJD9STp1Kcqhjl234reztc"
+	"/NNzMgvwcRJiLKWY5RaKWwxbEDOsgIcIp32gmNH057NqgAQcRAVfWLIVjqqTtQCk"
+	"j3ZgTFUZeYwXe2qKgV/jRAfwy9ZQAO/la9ccWh7Upwf3y6Z9MAqA+er/o6FUfIBD"
+	"nzSxBJvLlN5VuVXmp0bm5KT/wCYm/SIktDCIGAzIDo1ndowbhfTs6D/cMRzlMQgF"
+	"Qz6cwutaOGg13ojo0OLeqbNR/c8ERom5xcaMiGkJ4EPv30v4fb6lCtX+M3Soz+uh"
+	"a+tr9s0gWXPSrpyXWAWWrLl4yugXT5RxvLx7kWsCAwEAAaOCCFowgghWMBAGCSsG"
+	"AQQBgjcVAQQDAgEAMB0GA1UdDgQWBBS0dIurntt28H+lKOOUrTHMcvCzKTCCBdYG"
+	"A1UdIASCBc0wggXJMIIBFAYHYIE8AQEBATCCAQcwgaYGCCsGAQUFBwICMIGZHoGW"
+	"AEkAbQBwAGwAZQBtAGUAbgB0AGEAIABsAGEAIABQAG8AbABpAHQAaQBjAGEAIABk"
+	"AGUAIABsAGEAIABSAGEAaQB6ACAAQwBvAHMAdABhAHIAcgBpAGMAZQBuAHMAZQAg"
+	"AGQAZQAgAEMAZQByAHQAaQBmAGkAYwBhAGMAaQBvAG4AIABEAGkAZwBpAHQAYQBs"
+	"ACAAdgAyMCoGCCsGAQUFBwIBFh5odHRwOi8vd3d3LmZpcm1hZGlnaXRhbC5nby5j"
+	"cgAwMAYIKwYBBQUHAgEWJGh0dHA6Ly93d3cubWljaXQuZ28uY3IvZmlybWFkaWdp"
+	"dGFsADCCAVUGCGCBPAEBAQEBMIIBRzCB5gYIKwYBBQUHAgIwgdkegdYASQBtAHAA"
+	"bABlAG0AZQBuAHQAYQAgAGwAYQAgAFAAbwBsAGkAdABpAGMAYQAgAGQAZQAgAEMA"
+	"QQAgAEUAbQBpAHMAbwByAGEAIABwAGEAcgBhACAAUABlAHIAcwBvAG4AYQBzACAA"
+	"RgBpAHMAaQBjAGEAcwAgAHAAZQByAHQAZQBuAGUAYwBpAGUAbgB0AGUAIABhACAA"
+	"bABhACAAUABLAEkAIABOAGEAYwBpAG8AbgBhAGwAIABkAGUAIABDAG8AcwB0AGEA"
+	"IABSAGkAYwBhACAAdgAyMCoGCCsGAQUFBwIBFh5odHRwOi8vd3d3LmZpcm1hZGln"
+	"aXRhbC5nby5jcgAwMAYIKwYBBQUHAgEWJGh0dHA6Ly93d3cubWljaXQuZ28uY3Iv"
+	"ZmlybWFkaWdpdGFsADCCAagGCGCBPAEBAQECMIIBmjCCATgGCCsGAQUFBwICMIIB"
+	"Kh6CASYASQBtAHAAbABlAG0AZQBuAHQAYQAgAGwAYQAgAFAAbwBsAGkAdABpAGMA"
+	"YQAgAHAAYQByAGEAIABjAGUAcgB0AGkAZgBpAGMAYQBkAG8AIABkAGUAIABmAGkA"
+	"cgBtAGEAIABkAGkAZwBpAHQAYQBsACAAZABlACAAcABlAHIAcwBvAG4AYQBzACAA"
+	"ZgBpAHMAaQBjAGEAcwAgACgAYwBpAHUAZABhAGQAYQBuAG8ALwByAGUAcwBpAGQA"
+	"ZQBuAHQAZQApACAAcABlAHIAdABlAG4AZQBjAGkAZQBuAHQAZQAgAGEAIABsAGEA"
+	"IABQAEsASQAgAE4AYQBjAGkAbwBuAGEAbAAgAGQAZQAgAEMAbwBzAHQAYQAgAFIA"
+	"aQBjAGEAIAB2ADIwKgYIKwYBBQUHAgEWHmh0dHA6Ly93d3cuZmlybWFkaWdpdGFs"
+	"LmdvLmNyADAwBggrBgEFBQcCARYkaHR0cDovL3d3dy5taWNpdC5nby5jci9maXJt"
+	"YWRpZ2l0YWwAMIIBqAYIYIE8AQEBAQMwggGaMIIBOAYIKwYBBQUHAgIwggEqHoIB"
+	"JgBJAG0AcABsAGUAbQBlAG4AdABhACAAbABhACAAUABvAGwAaQB0AGkAYwBhACAA"
+	"cABhAHIAYQAgAGMAZQByAHQAaQBmAGkAYwBhAGQAbwAgAGQAZQAgAGEAdQB0AGUA"
+	"bgB0AGkAYwBhAGMAaQBvAG4AIABkAGUAIABwAGUAcgBzAG8AbgBhAHMAIABmAGkA"
+	"cwBpAGMAYQBzACAAKABjAGkAdQBkAGEAZABhAG4AbwAvAHIAZQBzAGkAZABlAG4A"
+	"dABlACkAIABwAGUAcgB0AGUAbgBlAGMAaQBlAG4AdABlACAAYQAgAGwAYQAgAFAA"
+	"SwBJACAATgBhAGMAaQBvAG4AYQBsACAAZABlACAAQwBvAHMAdABhACAAUgBpAGMA"
+	"YQAgAHYAMjAqBggrBgEFBQcCARYeaHR0cDovL3d3dy5maXJtYWRpZ2l0YWwuZ28u"
+	"Y3IAMDAGCCsGAQUFBwIBFiRodHRwOi8vd3d3Lm1pY2l0LmdvLmNyL2Zpcm1hZGln"
+	"aXRhbAAwGQYJKwYBBAGCNxQCBAweCgBTAHUAYgBDAEEwCwYDVR0PBAQDAgGGMBIG"
+	"A1UdEwEB/wQIMAYBAf8CAQAwHwYDVR0jBBgwFoAUaJ1pNsuEbnvqk2EZ/1gwHdX/"
+	"XMswgeoGA1UdHwSB4jCB3zCB3KCB2aCB1oZmaHR0cDovL3d3dy5maXJtYWRpZ2l0"
+	"YWwuZ28uY3IvcmVwb3NpdG9yaW8vQ0ElMjBQT0xJVElDQSUyMFBFUlNPTkElMjBG"
+	"SVNJQ0ElMjAtJTIwQ09TVEElMjBSSUNBJTIwdjIuY3JshmxodHRwOi8vd3d3Lm1p"
+	"Y2l0LmdvLmNyL2Zpcm1hZGlnaXRhbC9yZXBvc2l0b3Jpby9DQSUyMFBPTElUSUNB"
+	"JTIwUEVSU09OQSUyMEZJU0lDQSUyMC0lMjBDT1NUQSUyMFJJQ0ElMjB2Mi5jcmww"
+	"gf4GCCsGAQUFBwEBBIHxMIHuMHIGCCsGAQUFBzAChmZodHRwOi8vd3d3LmZpcm1h"
+	"ZGlnaXRhbC5nby5jci9yZXBvc2l0b3Jpby9DQSUyMFBPTElUSUNBJTIwUEVSU09O"
+	"QSUyMEZJU0lDQSUyMC0lMjBDT1NUQSUyMFJJQ0ElMjB2Mi5jcnQweAYIKwYBBQUH"
+	"MAKGbGh0dHA6Ly93d3cubWljaXQuZ28uY3IvZmlybWFkaWdpdGFsL3JlcG9zaXRv"
+	"cmlvL0NBJTIwUE9MSVRJQ0ElMjBQRVJTT05BJTIwRklTSUNBJTIwLSUyMENPU1RB"
+	"JTIwUklDQSUyMHYyLmNydDANBgkqhkiG9w0BAQ0FAAOCAgEAXMDsvznzaps0YruV"
+	"9IpoXIN3enrxNHnzu9eEW9ucl3jP3yOK4SfqwTYvJ8PKKaG+p5WxhVFVh5Qn2nm0"
+	"CPR8zrxMEskqg7GdScqIpoMe9ZojSEk4Xw19cHj3KN+eetp96lBpjTlva4ipz2ES"
+	"09tVUA/ctU6kRbMR22B9qjeSE8agrYKaUBc4n44h1W6K7itGkIMVB/wQ1nF8sxko"
+	"VOitqLXjVy7ZKTk+4+S0rWK7SYt2fkaQZA8tSSt6fatPx68+gDKSv3JXNWG+Nr8I"
+	"XZdyrpICwI/318JPPjR0QJnD7kivjZK2QFZCbuJu4rZoyblvXJLmei4QXpSIgRMg"
+	"Z0MJamP5dW2Xw3qq2YQS4ma8ZTCqecat5wFGsH81RR10JnpRp4A4NpftguvbnZhG"
+	"9m8kdmOKaq4R7NRp/wM/XZi0jxsvzdtUomquCQc+AJ26AZPWVy4nj+kglEJE759o"
+	"o/Qjpgu9PZrkEARInpjHzYBSeq6SCHud58pzZIwStlOMicLozcLAyOvgTKAjg9cQ"
+	"Bg1HVi1wT2aVL76tOAI0ZlCGiSnyGq3RUEKSC3TcFfTzpPJiHKw+6nPmTAAnCN8+"
+	"co+s0Prh/+Ju24hA8ShhKYy3ORQ+3u2l8EoyPUcl+EDOC2kufLbuF7AKrBDF0hXm"
+	"Lfon9nZBnfr/EpL/J1qRaM7am1s=",
+	// CA POLITICA PERSONA FISICA - COSTA RICA v2
+	"MIIMrDCCCpSgAwIBAgITTgAAAAJzjeZ3/o5oQAAAAAAAAjANBgkqhkiG9w0BAQ0F"
+	"ADBzMRkwFwYDVQQFExBDUEotMi0xMDAtMDk4MzExMQ0wCwYDVQQLEwREQ0ZEMQ8w"
+	"DQYDVQQKEwZNSUNJVFQxCzAJBgNVBAYTAkNSMSkwJwYDVQQDEyBDQSBSQUlaIE5B"
+	"Q0lPTkFMIC0gQ09TVEEgUklDQSB2MjAeFw0xNTAyMjUxODA4MzhaFw0zMTAyMjUx"
+	"ODE4MzhaMH0xGTAXBgNVBAUTEENQSi0yLTEwMC0wOTgzMTExCzAJBgNVBAYTAkNS"
+	"MQ8wDQYDVQQKEwZNSUNJVFQxDTALBgNVBAsTBERDRkQxMzAxBgNVBAMTKkNBIFBP"
+	"TElUSUNBIFBFUlNPTkEgRklTSUNBIC0gQ09TVEEgUklDQSB2MjCCAiIwDQYJKoZI"
+	"hvcNAQEBBQADggIPADCCAgoCggIBANkkXhbXpjPWMmmjmKLZBpk+EsM/nBp0JgPB"
+	"tQFmnmA0d4fPlKXy8/sD0buS1QRDZZAerSvprfyaiKPAEpZpOWCl2fu46MQyyTa1"
+	"DjH/ellvjADlOueC3p3O9qG5JIUrhuLTcx5G+eYyoJIURNob9O4Ur52+eTOYYqvJ"
+	"IYomKLc+/2pbJ0SApv+2m3p3oAp2SjTeWTMKVH6sPgqMD2izWJ3xChCefu2yec7N"
+	"YaGjS1aMefYDIN2uklX7IhBTf9ErGGIPQ6Jmgoe5GvYfLB7O1BgaTcC3ZIwvGfoA"
+	"owfiRYOzLfnuxuuTkUWFfafcYJTUYEkZimHeyEWh41M+kOkZE/q5jwQkfgTLGV+U"
+	"QpVGMKSkzsW5EdgcI51ynZBkunnJsglTys66EEfAnoLr3uhiS67AE2Qqvvp7NOUU"
+	"G1YCm7WOyEvVt1QbZUlkLZRxhlF5SKjmzhqruisBfmUz6tX6WO3EJyNT5N62YwQx"
+	"SULOatx90ztuxzCHHhCcoh3xOWhWYtTwx4F2QDiRqfXfyTw9Te4CGlzmOYSQIdnO"
+	"eTUTkDZ3WOxs2bAGgmGQQL+WtzIW3qj2xtspV4F7owwjlG+jhNHJzbjVxoYJoUJm"
+	"yR8NCBYkdl/iNxewSUcOseZz+VVvlYJrcI1pRuJ1cnhyvWF/ymc8N1ZGtUMauSel"
+	"r1tBGakNAgMBAAGjggctMIIHKTAQBgkrBgEEAYI3FQEEAwIBADAdBgNVHQ4EFgQU"
+	"aJ1pNsuEbnvqk2EZ/1gwHdX/XMswggTcBgNVHSAEggTTMIIEzzCCARQGB2CBPAEB"
+	"AQEwggEHMIGmBggrBgEFBQcCAjCBmR6BlgBJAG0AcABsAGUAbQBlAG4AdABhACAA"
+	"bABhACAAUABvAGwAaQB0AGkAYwBhACAAZABlACAAbABhACAAUgBhAGkAegAgAEMA"
+	"bwBzAHQAYQByAHIAaQBjAGUAbgBzAGUAIABkAGUAIABDAGUAcgB0AGkAZgBpAGMA"
+	"YQBjAGkAbwBuACAARABpAGcAaQB0AGEAbAAgAHYAMjAqBggrBgEFBQcCARYeaHR0"
+	"cDovL3d3dy5maXJtYWRpZ2l0YWwuZ28uY3IAMDAGCCsGAQUFBwIBFiRodHRwOi8v"
+	"d3d3Lm1pY2l0LmdvLmNyL2Zpcm1hZGlnaXRhbAAwggFVBghggTwBAQEBATCCAUcw"
+	"geYGCCsGAQUFBwICMIHZHoHWAEkAbQBwAGwAZQBtAGUAbgB0AGEAIABsAGEAIABw"
+	"AG8AbABpAHQAaQBjAGEAIABkAGUAIABDAEEAIABFAG0AaQBzAG8AcgBhACAAcABh"
+	"AHIAYQAgAFAAZQByAHMAbwBuAGEAcwAgAEYAaQBzAGkAYwBhAHMAIABwAGUAcgB0"
+	"AGUAbgBlAGMAaQBlAG4AdABlACAAYQAgAGwAYQAgAFAASwBJACAATgBhAGMAaQBv"
+	"AG4AYQBsACAAZABlACAAQwBvAHMAdABhACAAUgBpAGMAYQAgAHYAMjAqBggrBgEF"
+	"BQcCARYeaHR0cDovL3d3dy5maXJtYWRpZ2l0YWwuZ28uY3IAMDAGCCsGAQUFBwIB"
+	"FiRodHRwOi8vd3d3Lm1pY2l0LmdvLmNyL2Zpcm1hZGlnaXRhbAAwggErBghggTwB"
+	"AQEBAjCCAR0wgbwGCCsGAQUFBwICMIGvHoGsAEkAbQBwAGwAZQBtAGUAbgB0AGEA"
+	"IABsAGEAIABwAG8AbABpAHQAaQBjAGEAIABwAGEAcgBhACAAZgBpAHIAbQBhACAA"
+	"ZABpAGcAaQB0AGEAbAAgAGQAZQAgAHAAZQByAHMAbwBuAGEAcwAgAGYAaQBzAGkA"
+	"YwBhAHMAIAAoAGMAaQB1AGQAYQBkAGEAbgBvAC8AcgBlAHMAaQBkAGUAbgB0AGUA"
+	"KQAgAHYAMjAqBggrBgEFBQcCARYeaHR0cDovL3d3dy5maXJtYWRpZ2l0YWwuZ28u"
+	"Y3IAMDAGCCsGAQUFBwIBFiRodHRwOi8vd3d3Lm1pY2l0LmdvLmNyL2Zpcm1hZGln"
+	"aXRhbAAwggErBghggTwBAQEBAzCCAR0wgbwGCCsGAQUFBwICMIGvHoGsAEkAbQBw"
+	"AGwAZQBtAGUAbgB0AGEAIABsAGEAIABwAG8AbABpAHQAaQBjAGEAIABwAGEAcgBh"
+	"ACAAYQB1AHQAZQBuAHQAaQBjAGEAYwBpAG8AbgAgAGQAZQAgAHAAZQByAHMAbwBu"
+	"AGEAcwAgAGYAaQBzAGkAYwBhAHMAIAAoAGMAaQB1AGQAYQBkAGEAbgBvAC8AcgBl"
+	"AHMAaQBkAGUAbgB0AGUAKQAgAHYAMjAqBggrBgEFBQcCARYeaHR0cDovL3d3dy5m"
+	"aXJtYWRpZ2l0YWwuZ28uY3IAMDAGCCsGAQUFBwIBFiRodHRwOi8vd3d3Lm1pY2l0"
+	"LmdvLmNyL2Zpcm1hZGlnaXRhbAAwGQYJKwYBBAGCNxQCBAweCgBTAHUAYgBDAEEw"
+	"CwYDVR0PBAQDAgGGMA8GA1UdEwEB/wQFMAMBAf8wHwYDVR0jBBgwFoAU4PL+fcRE"
+	"TlDkNf0IiY9OhBlEM0AwgdIGA1UdHwSByjCBxzCBxKCBwaCBvoZaaHR0cDovL3d3"
+	"dy5maXJtYWRpZ2l0YWwuZ28uY3IvcmVwb3NpdG9yaW8vQ0ElMjBSQUlaJTIwTkFD"
+	"SU9OQUwlMjAtJTIwQ09TVEElMjBSSUNBJTIwdjIuY3JshmBodHRwOi8vd3d3Lm1p"
+	"Y2l0LmdvLmNyL2Zpcm1hZGlnaXRhbC9yZXBvc2l0b3Jpby9DQSUyMFJBSVolMjBO"
+	"QUNJT05BTCUyMC0lMjBDT1NUQSUyMFJJQ0ElMjB2Mi5jcmwwgeYGCCsGAQUFBwEB"
+	"BIHZMIHWMGYGCCsGAQUFBzAChlpodHRwOi8vd3d3LmZpcm1hZGlnaXRhbC5nby5j"
+	"ci9yZXBvc2l0b3Jpby9DQSUyMFJBSVolMjBOQUNJT05BTCUyMC0lMjBDT1NUQSUy"
+	"MFJJQ0ElMjB2Mi5jcnQwbAYIKwYBBQUHMAKGYGh0dHA6Ly93d3cubWljaXQuZ28u"
+	"Y3IvZmlybWFkaWdpdGFsL3JlcG9zaXRvcmlvL0NBJTIwUkFJWiUyME5BQ0lPTkFM"
+	"JTIwLSUyMENPU1RBJTIwUklDQSUyMHYyLmNydDANBgkqhkiG9w0BAQ0FAAOCAgEA"
+	"v5rU86FMttoAqCsAJGUQl7DboiQosF/FAvhX0YhsfYWRyUL5BOmuWjIMNuljuU5L"
+	"c6BR5eWePSUkOe3acDzslBkUjKzyNRZNQA7IXkuVs1arFT5djjhGiCdzwH7+rFek"
+	"bNxicdhWJSJ7Fge5dMTkErgDJDERAWfePgzg55hacoTCgX0RkBQDZ08UJMVNgNuo"
+	"gfGGfXYgliwoFj4SnwktHjJHmAptQyLi+tCrt4VWr8+G34FFL51bAvio+RABqD7n"
+	"u26cnnyNvZ5Ce4oMIcPxUkMX/LINqOFUjY75CcBhovqUJYEobbR9cvMcu3EC2su5"
+	"asHDWjZxiUQrvSRHvH+7jNYuSk84THfiNcZq99o9ra/pG3ufO07ox1IHDDlX6LX6"
+	"lTt6DbKw+5Z5L9I4GphhcxWxIdeNmg7xq60Cfy02sqLHeelOoweJLr97rliieeZk"
+	"XXkGRN62z+1/ZcdS4gj1v+JKHiYLquTkxZFVCo/GmjC5IfUV5SrwtF7vfsJF9Hkd"
+	"aEcsQ9iuKOS28OR4vR0baEsCvlMotJn3jMFbFYO/v/e9P/79T3e+cVi/Va//avW1"
+	"jxgCQGvTkca6RfqTr3WkMrnwZhHBvTvu0utoIRruw4vpbboFbrm6kkRbMYlA7Yop"
+	"UEBsMW+iqjp6jzifnlluqriqPuBAfmTv8ASr8JE8Ytw=",
+	// CA RAIZ NACIONAL - COSTA RICA v2
+	"MIIFwTCCA6mgAwIBAgIQdLjPY4+rcrxGwdK6zQAFDDANBgkqhkiG9w0BAQ0FADBz"
+	"MRkwFwYDVQQFExBDUEotMi0xMDAtMDk4MzExMQ0wCwYDVQQLEwREQ0ZEMQ8wDQYD"
+	"VQQKEwZNSUNJVFQxCzAJBgNVBAYTAkNSMSkwJwYDVQQDEyBDQSBSQUlaIE5BQ0lP"
+	"TkFMIC0gQ09TVEEgUklDQSB2MjAeFw0xNTAyMjQyMjE5NTVaFw0zOTAyMjQyMjI4"
+	"NDRaMHMxGTAXBgNVBAUTEENQSi0yLTEwMC0wOTgzMTExDTALBgNVBAsTBERDRkQx"
+	"DzANBgNVBAoTBk1JQ0lUVDELMAkGA1UEBhMCQ1IxKTAnBgNVBAMTIENBIFJBSVog"
+	"TkFDSU9OQUwgLSBDT1NUQSBSSUNBIHYyMIICIjANBgkqhkiG9w0BAQEFAAOCAg8A"
+	"MIICCgKCAgEAwnQxZdkRRU4vV9xiuV3HStB/7o3GB95pZL/NgdVXrSc+X1hxGtwg"
+	"wPyrc/SrLodUpXBYWD0zQNSQWkPpXkRoSa7guAjyHDpmfDkbRk2Oj414OpN3Etoe"
+	"hrw9pBWgHrFK1e5+oj2iHj1QRBUPlcyKJTz+DyOgvY2wC5Tgyxj4Fn2Tqy79Ck6U"
+	"lerJgp8xRbPJwuF/2apBlzXu+/zvV3Pv2MMrPvSMpVK0oAw47TLpSzNRG3Z88V9P"
+	"hPdkEyvqstdWQHiuFp49ulRvsr1cRdmkNptO0q6udPyej3k50Dl8IzhW1Uv5yPCK"
+	"pxpDpoyy3X6HnfmZ470lbhzTZ12AQ392ansLLnO/ZOT4E9JB1M2UiZox8TdGe5RK"
+	"DNQGK2GWJIQKDsIZqcVCmbGrCRPxCOtC/NwILxQCu8k1TkeH8SlrkwiBMsoCu5qe"
+	"NrkarQxEYcVNXyw0rAaofaNL/42a5x7ulg78bNFBMj3vXM81WyFt+K3Ef+Zzd94i"
+	"b/iOuzajKCIxiI+lp0PaNiVgj4a3h5BJM74umhCv0U+TAqIljp5QqPJvikcT4PgU"
+	"4OS9/kCNxpKYqHJzRoijHWeA+EOSlAnuztya9KQLzmzoC/gQ4hqVfk2UNQ57DKdk"
+	"uPbBTFvCSTjzRV+J7lfpci+WhT1BCRgUKSIwGEHYOm1dvjWOydRQBzcCAwEAAaNR"
+	"ME8wCwYDVR0PBAQDAgGGMA8GA1UdEwEB/wQFMAMBAf8wHQYDVR0OBBYEFODy/n3E"
+	"RE5Q5DX9CImPToQZRDNAMBAGCSsGAQQBgjcVAQQDAgEAMA0GCSqGSIb3DQEBDQUA"
+	"A4ICAQBJ5nSJMjsLLttbQWOESI3JjGtP7LIEIQCMAjM7WJTmUDMK1Xd+LKGq/vMz"
+	"v0OnlCVsM4D7pnpWyEU30n9BvwCk4/bcp/ka/NBbE0fXNVF2px0T369RmfSBR32+"
+	"y67kwfV9wT2lsm1M6faOCtLXgOe0UaCD5shbegU8RQhk2owSQTj6ZeXKQSnr5dv6"
+	"z4nE5hFUFCMWYvbO9Lq9EyzzzMOEbV4fOu9PVgPQ5wARzJ0pf0evH9SnId5Y1nvS"
+	"AYkHPgoiqiaSlcy9nN2C+QHwvt89nIH4krkSp0bLjX7ww8UgSzJnmrwWrjqt0c+O"
+	"pOEkBlkmz2WeRK6G7fvov8SFSjZkMaiAKRHbxAuDSs+HAG9xzrI7OjvaLuVq5w0r"
+	"3p77XT70Hiv6M/8ysMP3FpjNcK8xHjtOupjqVhK+KqBAhC8Z7fIyPH8U2vXPexCO"
+	"449G930dnK4S8S6CpCh4bdRuZg/n+vRa9Cf/GheO56aANt+unoPf1tfYhKcFGx40"
+	"lSBxoQtx6eR8TMhuQBJBwd4IRG/cy6ysE0vF2WKikc+m7a8vJYk+Did3n3nHKFKA"
+	"Bh0Fdf6Id1/KiyXO0ivm1xR7uK0mreiETRcWa7Pw2D1NllnuoIyx1gsc0eYmZnZC"
+	"5lV7VBt1xfpCyaRtmcqU7Jzvk/rl9U8rMSpaOcySGf15dGPVtQ=="
+};
+
+static const std::size_t chain_certificates_size =
+	sizeof(chain_certificates) / sizeof(chain_certificates[0]);
+
+
+/* Límite de saltos al construir una cadena, por si hubiera ciclos. */
+#define FIRMADOR_CHAIN_DEPTH 8
+
+struct chain_ca_t {
+	/* Identificador de clave de la autoridad emisora (AKI). */
+	std::string authority;
+	/* Este certificado como cadena JSON. */
+	std::string json;
+	/* Este certificado y sus emisores como cadenas JSON separadas. */
+	std::string chain;
+};
+
+/*
+ * Índice de las CA por identificador de clave del sujeto (SKI). Se construye
+ * al arrancar y después solamente se lee, así que no necesita cerrojos.
+ */
+typedef std::unordered_map<std::string, chain_ca_t> chain_index_t;
+
+static chain_index_t chain_index;
+
+static std::string chain_key_id(gnutls_x509_crt_t cert, bool authority) {
+	unsigned char id[64];
+	std::size_t id_size = sizeof(id);
+	int ret;
+
+	if (authority) {
+		ret = gnutls_x509_crt_get_authority_key_id(cert, id, &id_size,
+			NULL);
+	} else {
+		ret = gnutls_x509_crt_get_subject_key_id(cert, id, &id_size,
+			NULL);
+	}
+	if (ret < GNUTLS_E_SUCCESS) {
+		return std::string();
+	}
+
+	return std::string((const char*)id, id_size);
+}
+
+static int chain_add(gnutls_x509_crt_t cert) {
+	std::string subject = chain_key_id(cert, false);
+	if (subject.empty()) {
+		return GNUTLS_E_REQUESTED_DATA_NOT_AVAILABLE;
+	}
+
+	gnutls_datum_t cert_der;
+	int ret = gnutls_x509_crt_export2(cert, GNUTLS_X509_FMT_DER, &cert_der);
+	if (ret < GNUTLS_E_SUCCESS) {
+		return ret;
+	}
+	std::string certificate = base64_encode(cert_der.data, cert_der.size);
+	gnutls_free(cert_der.data);
+
+	rapidjson::StringBuffer stringBuffer;
+	rapidjson::Writer<rapidjson::StringBuffer> writer(stringBuffer);
+	writer.String(certificate.c_str(), certificate.length());
+
+	chain_ca_t &ca = chain_index[subject];
+	ca.authority = chain_key_id(cert, true);
+	ca.json.assign(stringBuffer.GetString(), stringBuffer.GetSize());
+
+	return GNUTLS_E_SUCCESS;
+}
+
+static int chain_add_datum(const gnutls_datum_t &datum,
+	gnutls_x509_crt_fmt_t format) {
+
+	gnutls_x509_crt_t *certs;
+	unsigned int certs_size = 0;
+
+	int ret = gnutls_x509_crt_list_import2(&certs, &certs_size, &datum,
+		format, 0);
+	if (ret < GNUTLS_E_SUCCESS) {
+		return ret;
+	}
+
+	for (unsigned int i = 0; i < certs_size; i++) {
+		if (ret == GNUTLS_E_SUCCESS) {
+			ret = chain_add(certs[i]);
+		}
+		gnutls_x509_crt_deinit(certs[i]);
+	}
+	gnutls_free(certs);
+
+	return ret;
+}
+
+/*
+ * Cada fichero se proyecta en memoria y se importa directamente desde ahí.
+ * Puede estar en DER o en PEM con uno o varios certificados.
+ */
+static void chain_add_file(const std::string &path) {
+	FileMapping file(path);
+	if (!file.valid()) {
+		return;
+	}
+
+	static const char pem[] = "-----BEGIN";
+	const unsigned char *end = file.data() + file.size();
+	gnutls_x509_crt_fmt_t format = GNUTLS_X509_FMT_DER;
+	if (std::search(file.data(), end, pem, pem + sizeof(pem) - 1) != end) {
+		format = GNUTLS_X509_FMT_PEM;
+	}
+
+	gnutls_datum_t datum = {const_cast<unsigned char *>(file.data()),
+		(unsigned) file.size()};
+
+	chain_add_datum(datum, format);
+}
+
+/* Resuelve de antemano la cadena completa de cada CA del índice. */
+static void chain_link() {
+	for (chain_index_t::iterator it = chain_index.begin();
+		it != chain_index.end(); ++it) {
+		std::string chain = it->second.json;
+		std::string subject = it->first;
+		const chain_ca_t *ca = &it->second;
+
+		for (int depth = 0; depth < FIRMADOR_CHAIN_DEPTH
+			&& !ca->authority.empty()
+			&& ca->authority != subject; depth++) {
+			chain_index_t::const_iterator issuer =
+				chain_index.find(ca->authority);
+			if (issuer == chain_index.end()) {
+				break;
+			}
+			chain += "," + issuer->second.json;
+			subject = issuer->first;
+			ca = &issuer->second;
+		}
+
+		it->second.chain = chain;
+	}
+}
+
+/*
+ * Carga la cadena incluida en el programa, que debe ser válida, y después las
+ * CA del directorio indicado, si existe. Los ficheros que no contengan
+ * certificados válidos se ignoran.
+ */
+int chain_load(const std::string &directory) {
+	for (std::size_t i = 0; i < chain_certificates_size; i++) {
+		std::string pem = std::string("-----BEGIN CERTIFICATE-----\n")
+			+ chain_certificates[i]
+			+ "\n-----END CERTIFICATE-----\n";
+		gnutls_datum_t datum = {(unsigned char*)pem.c_str(),
+			(unsigned)pem.length()};
+
+		int ret = chain_add_datum(datum, GNUTLS_X509_FMT_PEM);
+		if (ret < GNUTLS_E_SUCCESS) {
+			return ret;
+		}
+	}
+
+	std::vector<std::string> files;
+	if (!directory.empty() && file_list(directory, files) == 0) {
+		for (std::size_t i = 0; i < files.size(); i++) {
+			chain_add_file(files.at(i));
+		}
+	}
+
+	chain_link();
+
+	return GNUTLS_E_SUCCESS;
+}
+
+/*
+ * Devuelve la cadena del emisor con ese AKI ya escrita como cadenas JSON
+ * separadas por comas, o vacía si el emisor no está en el índice.
+ */
+const std::string &chain_fragment(const std::string &authority) {
+	static const std::string empty;
+
+	chain_index_t::const_iterator it = chain_index.find(authority);
+	if (it == chain_index.end()) {
+		return empty;
+	}
+
+	return it->second.chain;
+}
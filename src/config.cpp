@@ -0,0 +1,145 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "config.h"
+
+#include <cstdlib>
+
+#ifndef FIRMADOR_SYSCONFDIR
+# define FIRMADOR_SYSCONFDIR "/etc"
+#endif
+
+#ifdef _WIN32
+# define FIRMADOR_CONFIG_SEPARATOR ';'
+#else
+# define FIRMADOR_CONFIG_SEPARATOR ':'
+#endif
+
+static unsigned long config_number(const char *name, unsigned long fallback) {
+	const char *value = getenv(name);
+	if (value == NULL || value[0] == 0) {
+		return fallback;
+	}
+
+	char *end;
+	unsigned long number = strtoul(value, &end, 10);
+	if (*end != 0) {
+		return fallback;
+	}
+
+	return number;
+}
+
+static std::string config_string(const char *name, const char *fallback) {
+	const char *value = getenv(name);
+	if (value == NULL || value[0] == 0) {
+		return fallback;
+	}
+
+	return value;
+}
+
+/* Directorio de datos propio del usuario según el sistema. */
+static std::string config_data_directory() {
+#if defined(_WIN32)
+	return config_string("APPDATA", ".") + "\\firmador";
+#elif defined(__APPLE__)
+	return config_string("HOME", ".")
+		+ "/Library/Application Support/firmador";
+#else
+	const char *data = getenv("XDG_DATA_HOME");
+	if (data != NULL && data[0] == '/') {
+		return std::string(data) + "/firmador";
+	}
+
+	return config_string("HOME", ".") + "/.local/share/firmador";
+#endif
+}
+
+/*
+ * Lista de módulos separados como en PATH. Sin ella, el módulo del fabricante
+ * de la tarjeta en los sistemas que soporta.
+ */
+static std::vector<std::string> config_providers() {
+	std::vector<std::string> providers;
+	std::string value = config_string("FIRMADOR_PROVIDER", "");
+
+	std::size_t start = 0;
+	while (start < value.length()) {
+		std::size_t end = value.find(FIRMADOR_CONFIG_SEPARATOR, start);
+		if (end == std::string::npos) {
+			end = value.length();
+		}
+		if (end > start) {
+			providers.push_back(value.substr(start, end - start));
+		}
+		start = end + 1;
+	}
+
+	if (value.empty()) {
+#if defined(_WIN32)
+		providers.push_back(config_string("WINDIR", "C:\\Windows")
+			+ "\\System32\\asepkcs.dll");
+#elif defined(__APPLE__)
+		providers.push_back(
+			"/Library/Application Support/Athena/libASEP11.dylib");
+#elif defined(__linux__)
+		providers.push_back("/usr/lib/x64-athena/libASEP11.so");
+#endif
+	}
+
+	return providers;
+}
+
+static config_t config_read() {
+	config_t config;
+
+	config.session_ttl = config_number("FIRMADOR_SESSION_TTL", 0);
+	config.session_operations = config_number(
+		"FIRMADOR_SESSION_OPERATIONS", 0);
+	config.session_max = config_number("FIRMADOR_SESSION_MAX", 4);
+	config.ca_directory = config_string("FIRMADOR_CA_DIR",
+		FIRMADOR_SYSCONFDIR "/firmador/ca");
+	config.keepalive = config_number("FIRMADOR_KEEPALIVE", 1) != 0;
+	config.connection_timeout = config_number(
+		"FIRMADOR_CONNECTION_TIMEOUT", 15);
+	config.connection_requests = config_number(
+		"FIRMADOR_CONNECTION_REQUESTS", 100);
+	config.body_max = config_number("FIRMADOR_BODY_MAX", 1048576);
+	config.slot_timeout = config_number("FIRMADOR_SLOT_TIMEOUT", 5);
+	config.headless = config_number("FIRMADOR_HEADLESS", 0) != 0;
+	config.prompt = config_string("FIRMADOR_PROMPT", "");
+	config.pinentry = config_string("FIRMADOR_PINENTRY", "pinentry");
+	config.pin_file = config_string("FIRMADOR_PIN_FILE", "");
+	config.idle_timeout = config_number("FIRMADOR_IDLE_TIMEOUT", 0);
+	config.tls = config_number("FIRMADOR_TLS", 0) != 0;
+	config.tls_certificate = config_string("FIRMADOR_TLS_CERT", "");
+	config.tls_key = config_string("FIRMADOR_TLS_KEY", "");
+	config.tls_directory = config_string("FIRMADOR_TLS_DIR",
+		config_data_directory().c_str());
+	config.providers = config_providers();
+
+	return config;
+}
+
+const config_t &config() {
+	static const config_t config = config_read();
+
+	return config;
+}
@@ -0,0 +1,77 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef FIRMADOR_CONFIG_H
+#define FIRMADOR_CONFIG_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/*
+ * Opciones leídas de variables de entorno FIRMADOR_* al arrancar. Los valores
+ * por omisión reproducen el comportamiento de siempre.
+ */
+struct config_t {
+	/* Segundos de inactividad que se mantiene abierta una sesión. */
+	unsigned long session_ttl;
+	/* Firmas por sesión antes de cerrarla, 0 sin límite. */
+	unsigned long session_operations;
+	/* Sesiones abiertas a la vez como máximo. */
+	std::size_t session_max;
+	/* Directorio con certificados de CA adicionales, en DER o PEM. */
+	std::string ca_directory;
+	/* Reutilizar la conexión HTTP entre peticiones. */
+	bool keepalive;
+	/* Segundos de inactividad antes de cerrar una conexión. */
+	unsigned long connection_timeout;
+	/* Peticiones por conexión antes de cerrarla, 0 sin límite. */
+	unsigned long connection_requests;
+	/* Tamaño máximo en bytes del cuerpo de una petición. */
+	unsigned long body_max;
+	/* Segundos de espera por la lectura de cada token. */
+	unsigned long slot_timeout;
+	/* Sin wxWidgets aunque se haya compilado con interfaz gráfica. */
+	bool headless;
+	/* Forma de pedir PIN y certificado: gui, pinentry o console. */
+	std::string prompt;
+	/* Programa pinentry. */
+	std::string pinentry;
+	/* Archivo con el PIN para la consola, en lugar de la entrada. */
+	std::string pin_file;
+	/* Segundos sin conexiones tras los que termina, 0 nunca. */
+	unsigned long idle_timeout;
+	/* Servir por HTTPS con el certificado y la clave indicados, en PEM. */
+	bool tls;
+	std::string tls_certificate;
+	std::string tls_key;
+	/* Sin certificado indicado, dónde se guardan la CA y localhost. */
+	std::string tls_directory;
+	/*
+	 * Módulos PKCS#11, el de la tarjeta de Firma Digital si no se indican
+	 * otros. Si entre ellos figura la entrada "p11-kit"
+	 * (FIRMADOR_PROVIDER_DISCOVERY), se cargan además los registrados en
+	 * p11-kit.
+	 */
+	std::vector<std::string> providers;
+};
+
+const config_t &config();
+
+#endif
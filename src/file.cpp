@@ -0,0 +1,228 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "file.h"
+
+#ifndef _WIN32
+# include <cerrno>
+# include <cstdio>
+# include <dirent.h>
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#else
+# include <windows.h>
+#endif
+
+#ifndef _WIN32
+FileMapping::FileMapping(const std::string &path) : mapped(NULL), length(0) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+		void *address = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+			fd, 0);
+		if (address != MAP_FAILED) {
+			mapped = address;
+			length = st.st_size;
+		}
+	}
+	close(fd);
+}
+
+FileMapping::~FileMapping() {
+	if (mapped != NULL) {
+		munmap(mapped, length);
+	}
+}
+
+int file_list(const std::string &directory, std::vector<std::string> &files) {
+	DIR *dir = opendir(directory.c_str());
+	if (dir == NULL) {
+		return -1;
+	}
+
+	struct dirent *entry;
+	while ((entry = readdir(dir)) != NULL) {
+		if (entry->d_name[0] == '.') {
+			continue;
+		}
+		files.push_back(directory + "/" + entry->d_name);
+	}
+	closedir(dir);
+
+	return 0;
+}
+/* Crea el directorio y los que falten por encima, solo para el usuario. */
+int file_directory(const std::string &directory) {
+	for (std::size_t pos = 1; pos <= directory.length(); pos++) {
+		if (pos < directory.length() && directory[pos] != '/') {
+			continue;
+		}
+		std::string path = directory.substr(0, pos);
+		if (mkdir(path.c_str(), 0700) != 0 && errno != EEXIST) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Escribe en un temporal legible solo por el usuario y lo renombra, para que
+ * nunca quede a medias ni con otros permisos. Un temporal que haya dejado una
+ * ejecución anterior se borra antes, porque abrirlo conservaría sus permisos
+ * y su dueño.
+ */
+int file_write(const std::string &path, const void *data, std::size_t size) {
+	std::string temporary = path + ".tmp";
+	if (unlink(temporary.c_str()) != 0 && errno != ENOENT) {
+		return -1;
+	}
+	int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0600);
+	if (fd < 0) {
+		return -1;
+	}
+
+	const char *buffer = static_cast<const char *>(data);
+	while (size > 0) {
+		ssize_t written = write(fd, buffer, size);
+		if (written < 0 && errno == EINTR) {
+			continue;
+		}
+		if (written <= 0) {
+			close(fd);
+			unlink(temporary.c_str());
+			return -1;
+		}
+		buffer += written;
+		size -= written;
+	}
+
+	if (fsync(fd) != 0 || close(fd) != 0
+		|| rename(temporary.c_str(), path.c_str()) != 0) {
+		unlink(temporary.c_str());
+		return -1;
+	}
+
+	return 0;
+}
+#else
+FileMapping::FileMapping(const std::string &path) : mapped(NULL), length(0),
+	file(INVALID_HANDLE_VALUE), mapping(NULL) {
+
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return;
+	}
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+		return;
+	}
+
+	mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL) {
+		return;
+	}
+
+	mapped = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (mapped != NULL) {
+		length = (std::size_t) file_size.QuadPart;
+	}
+}
+
+FileMapping::~FileMapping() {
+	if (mapped != NULL) {
+		UnmapViewOfFile(mapped);
+	}
+	if (mapping != NULL) {
+		CloseHandle(mapping);
+	}
+	if (file != INVALID_HANDLE_VALUE) {
+		CloseHandle(file);
+	}
+}
+
+int file_list(const std::string &directory, std::vector<std::string> &files) {
+	WIN32_FIND_DATAA data;
+	HANDLE find = FindFirstFileA((directory + "\\*").c_str(), &data);
+	if (find == INVALID_HANDLE_VALUE) {
+		return -1;
+	}
+
+	do {
+		if (data.cFileName[0] == '.'
+			|| (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+			continue;
+		}
+		files.push_back(directory + "\\" + data.cFileName);
+	} while (FindNextFileA(find, &data));
+	FindClose(find);
+
+	return 0;
+}
+
+/* Dentro del perfil del usuario hereda sus permisos. */
+int file_directory(const std::string &directory) {
+	for (std::size_t pos = 1; pos <= directory.length(); pos++) {
+		if (pos < directory.length() && directory[pos] != '\\'
+			&& directory[pos] != '/') {
+			continue;
+		}
+		std::string path = directory.substr(0, pos);
+		if (path.length() == 2 && path[1] == ':') {
+			continue;
+		}
+		if (!CreateDirectoryA(path.c_str(), NULL)
+			&& GetLastError() != ERROR_ALREADY_EXISTS) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+int file_write(const std::string &path, const void *data, std::size_t size) {
+	std::string temporary = path + ".tmp";
+	HANDLE file = CreateFileA(temporary.c_str(), GENERIC_WRITE, 0, NULL,
+		CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return -1;
+	}
+
+	DWORD written;
+	BOOL ok = WriteFile(file, data, (DWORD) size, &written, NULL)
+		&& written == size && FlushFileBuffers(file);
+	CloseHandle(file);
+
+	if (!ok || !MoveFileExA(temporary.c_str(), path.c_str(),
+		MOVEFILE_REPLACE_EXISTING)) {
+		DeleteFileA(temporary.c_str());
+		return -1;
+	}
+
+	return 0;
+}
+#endif
@@ -0,0 +1,55 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef FIRMADOR_FILE_H
+#define FIRMADOR_FILE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/* Fichero proyectado en memoria en modo de solo lectura. */
+class FileMapping {
+public:
+	explicit FileMapping(const std::string &path);
+	~FileMapping();
+
+	bool valid() const { return mapped != NULL; }
+	const unsigned char *data() const {
+		return static_cast<const unsigned char *>(mapped);
+	}
+	std::size_t size() const { return length; }
+
+private:
+	FileMapping(const FileMapping &);
+	FileMapping &operator=(const FileMapping &);
+
+	void *mapped;
+	std::size_t length;
+#ifdef _WIN32
+	void *file;
+	void *mapping;
+#endif
+};
+
+int file_list(const std::string &directory, std::vector<std::string> &files);
+int file_directory(const std::string &directory);
+int file_write(const std::string &path, const void *data, std::size_t size);
+
+#endif
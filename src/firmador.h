@@ -20,11 +20,8 @@ along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
 #ifndef FIRMADOR_H
 #define FIRMADOR_H
 
-#ifndef _WIN32
-# include <arpa/inet.h>
-#else
+#ifdef _WIN32
 # define UNICODE
-# include <winsock2.h>
 #endif
 
 #include <wx/wxprec.h>
@@ -32,9 +29,21 @@ along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
 # include <wx/wx.h>
 #endif
 
+/* Aplicación de escritorio: el servicio más los diálogos de wxWidgets. */
 class Firmador: public wxApp {
 public:
 	virtual bool OnInit();
+	virtual int OnExit();
+
+private:
+	void OnGuiCall(wxCommandEvent &event);
+	void OnIdleTimer(wxTimerEvent &event);
+
+	wxTimer idle_timer;
+
+	DECLARE_EVENT_TABLE()
 };
 
+DECLARE_APP(Firmador)
+
 #endif
@@ -0,0 +1,198 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "gui.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <set>
+
+#include <gnutls/gnutls.h>
+
+DEFINE_EVENT_TYPE(FIRMADOR_EVT_GUI_CALL)
+
+struct gui_call_t {
+	std::function<void()> function;
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool done;
+};
+
+/*
+ * Un diálogo modal procesa eventos pendientes, así que sin este cerrojo una
+ * segunda petición abriría su diálogo encima del primero.
+ */
+static std::mutex gui_mutex;
+
+/*
+ * Llamadas enviadas al hilo principal que aún esperan. Al cerrar, este deja
+ * de procesar eventos; gui_shutdown() las da por terminadas sin ejecutarlas
+ * y los eventos que lleguen después se descartan.
+ */
+static std::set<gui_call_t *> gui_pending;
+static std::mutex gui_pending_mutex;
+static bool gui_closing = false;
+
+void gui_call(const std::function<void()> &function) {
+	if (wxIsMainThread()) {
+		function();
+		return;
+	}
+
+	std::lock_guard<std::mutex> gui_lock(gui_mutex);
+
+	gui_call_t call;
+	call.function = function;
+	call.done = false;
+
+	{
+		std::lock_guard<std::mutex> pending_lock(gui_pending_mutex);
+		if (gui_closing) {
+			return;
+		}
+		gui_pending.insert(&call);
+	}
+
+	wxCommandEvent event(FIRMADOR_EVT_GUI_CALL);
+	event.SetClientData(&call);
+	wxPostEvent(wxTheApp, event);
+
+	{
+		std::unique_lock<std::mutex> lock(call.mutex);
+		while (!call.done) {
+			call.condition.wait(lock);
+		}
+	}
+
+	std::lock_guard<std::mutex> pending_lock(gui_pending_mutex);
+	gui_pending.erase(&call);
+}
+
+void gui_call_run(void *data) {
+	gui_call_t *call = static_cast<gui_call_t *>(data);
+
+	{
+		std::lock_guard<std::mutex> pending_lock(gui_pending_mutex);
+		if (gui_pending.count(call) == 0) {
+			return;
+		}
+	}
+
+	call->function();
+
+	std::lock_guard<std::mutex> lock(call->mutex);
+	call->done = true;
+	call->condition.notify_one();
+}
+
+void gui_shutdown() {
+	std::lock_guard<std::mutex> pending_lock(gui_pending_mutex);
+	gui_closing = true;
+
+	for (std::set<gui_call_t *>::iterator it = gui_pending.begin();
+		it != gui_pending.end(); ++it) {
+		std::lock_guard<std::mutex> lock((*it)->mutex);
+		(*it)->done = true;
+		(*it)->condition.notify_one();
+	}
+}
+
+int GuiPrompt::pin(const std::string &description, char *pin,
+	std::size_t pin_max) {
+
+	int ret = -1;
+
+	/* Se llama desde los hilos de trabajo durante el inicio de sesión. */
+	gui_call([&]() {
+		wxPasswordEntryDialog pinDialog(NULL,
+			wxString(description.c_str(), wxConvUTF8),
+			wxT("Introducción del PIN"), wxEmptyString,
+			wxTextEntryDialogStyle | wxSTAY_ON_TOP);
+
+		if (pinDialog.ShowModal() != wxID_OK) {
+			return;
+		}
+
+		/*
+		 * Una sola copia del PIN fuera del diálogo, que se borra
+		 * después de pasarla a GnuTLS.
+		 */
+		wxCharBuffer value = pinDialog.GetValue().mb_str(wxConvUTF8);
+		std::size_t value_len = value.data() == NULL ? 0
+			: std::char_traits<char>::length(value.data());
+
+		if (value_len == 0) {
+			wxMessageBox(
+				wxString("No se ha introducido ningún valor",
+					wxConvUTF8),
+				wxT("PIN en blanco"));
+			return;
+		}
+
+		std::size_t len = std::min(pin_max - 1, value_len);
+		memcpy(pin, value.data(), len);
+		pin[len] = 0;
+		gnutls_memset(const_cast<char *>(value.data()), 0, value_len);
+
+		ret = 0;
+	});
+
+	return ret;
+}
+
+int GuiPrompt::select(const std::vector<certificate_t> &certificates) {
+	int selection = -1;
+
+	gui_call([&certificates, &selection]() {
+		if (certificates.empty()) {
+			wxMessageBox(wxString(
+				"No se ha encontrado ningún certificado de "
+				"firma en los dispositivos conectados.",
+				wxConvUTF8),
+				wxT("Certificado no seleccionado"),
+				wxICON_ERROR);
+			return;
+		}
+
+		wxArrayString cert_captions;
+		for (std::size_t i = 0; i < certificates.size(); i++) {
+			cert_captions.Add(wxString(
+				certificates.at(i).caption.c_str(),
+				wxConvUTF8));
+		}
+
+		wxSingleChoiceDialog choiceDialog(NULL,
+			wxT("Seleccionar el certificado con el que se desea "
+				"firmar."),
+			wxT("Selección de certificado"), cert_captions);
+
+		if (choiceDialog.ShowModal() == wxID_OK) {
+			selection = choiceDialog.GetSelection();
+		} else {
+			wxMessageBox(wxString(
+				"Se ha cancelado la selección de certificado.",
+				wxConvUTF8),
+				wxT("Certificado no seleccionado"));
+		}
+	});
+
+	return selection;
+}
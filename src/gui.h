@@ -0,0 +1,54 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef FIRMADOR_GUI_H
+#define FIRMADOR_GUI_H
+
+#include "prompt.h"
+
+#include <functional>
+#include <vector>
+
+#include <wx/wxprec.h>
+#ifndef WX_PRECOMP
+# include <wx/wx.h>
+#endif
+
+DECLARE_EVENT_TYPE(FIRMADOR_EVT_GUI_CALL, -1)
+
+/*
+ * Los diálogos de wxWidgets solamente pueden usarse desde el hilo principal.
+ * gui_call() ejecuta la función en ese hilo y espera a que termine, de modo
+ * que los hilos de trabajo pueden pedir PIN o certificado de forma síncrona.
+ * Tras gui_shutdown(), que el hilo principal llama al salir, las llamadas
+ * pendientes y las nuevas vuelven sin ejecutar la función.
+ */
+void gui_call(const std::function<void()> &function);
+void gui_call_run(void *data);
+void gui_shutdown();
+
+/* PIN y certificado con diálogos de wxWidgets. */
+class GuiPrompt : public Prompt {
+public:
+	virtual int pin(const std::string &description, char *pin,
+		std::size_t pin_max);
+	virtual int select(const std::vector<certificate_t> &certificates);
+};
+
+#endif
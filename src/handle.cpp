@@ -0,0 +1,95 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "handle.h"
+#include "token.h"
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+/*
+ * Tabla de los tokenId emitidos en /rest/certificates. Con el tokenId y el
+ * keyId de /rest/sign se obtiene directamente la URL de la clave, sin volver
+ * a recorrer los tokens. La clave importada la guarda la caché de sesiones,
+ * que aplica su propia política de caducidad. Se descartan las entradas usadas
+ * hace más tiempo cuando se llena y las de un token cuando se retira.
+ */
+typedef std::list<std::pair<std::string, handle_t> > handles_t;
+
+static handles_t handles;
+static std::unordered_map<std::string, handles_t::iterator> handles_index;
+static std::mutex handles_mutex;
+
+void handle_register(const std::string &token_id,
+	const certificate_t &certificate) {
+
+	handle_t handle;
+	handle.certificate = certificate;
+	handle.key_url = token_key_url(certificate.url);
+
+	std::lock_guard<std::mutex> lock(handles_mutex);
+
+	if (handles.size() >= FIRMADOR_HANDLE_MAX) {
+		handles_index.erase(handles.back().first);
+		handles.pop_back();
+	}
+	handles.push_front(std::make_pair(token_id, handle));
+	handles_index[token_id] = handles.begin();
+}
+
+bool handle_find(const std::string &token_id, const std::string &key_id,
+	handle_t &handle) {
+
+	std::lock_guard<std::mutex> lock(handles_mutex);
+
+	std::unordered_map<std::string, handles_t::iterator>::iterator it =
+		handles_index.find(token_id);
+	if (it == handles_index.end()
+		|| certificate_key_id(it->second->second.certificate)
+		!= key_id) {
+		return false;
+	}
+
+	handles.splice(handles.begin(), handles, it->second);
+	handle = it->second->second;
+
+	return true;
+}
+
+void handle_invalidate(const std::string &serial) {
+	std::lock_guard<std::mutex> lock(handles_mutex);
+
+	for (handles_t::iterator it = handles.begin(); it != handles.end(); ) {
+		if (it->second.certificate.serial == serial) {
+			handles_index.erase(it->first);
+			it = handles.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+void handle_clear() {
+	std::lock_guard<std::mutex> lock(handles_mutex);
+
+	handles_index.clear();
+	handles.clear();
+}
@@ -0,0 +1,42 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef FIRMADOR_HANDLE_H
+#define FIRMADOR_HANDLE_H
+
+#include "certificate.h"
+
+#include <string>
+
+#define FIRMADOR_HANDLE_MAX 64
+
+/* Certificado entregado al navegador y URL de su clave privada. */
+struct handle_t {
+	certificate_t certificate;
+	std::string key_url;
+};
+
+void handle_register(const std::string &token_id,
+	const certificate_t &certificate);
+bool handle_find(const std::string &token_id, const std::string &key_id,
+	handle_t &handle);
+void handle_invalidate(const std::string &serial);
+void handle_clear();
+
+#endif
@@ -0,0 +1,368 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "json.h"
+
+#include <cstring>
+
+JsonReader::JsonReader(JsonHandler &handler) : handler(handler),
+	state(STATE_VALUE), key(false), unicode(0), unicode_digits(0),
+	surrogate(0) {
+}
+
+static bool json_space(char c) {
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static int json_hex(char c) {
+	if (c >= '0' && c <= '9') {
+		return c - '0';
+	}
+	if (c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	}
+	if (c >= 'A' && c <= 'F') {
+		return c - 'A' + 10;
+	}
+
+	return -1;
+}
+
+static void json_utf8(std::string &out, unsigned int code) {
+	if (code < 0x80) {
+		out += (char) code;
+	} else if (code < 0x800) {
+		out += (char) (0xC0 | (code >> 6));
+		out += (char) (0x80 | (code & 0x3F));
+	} else if (code < 0x10000) {
+		out += (char) (0xE0 | (code >> 12));
+		out += (char) (0x80 | ((code >> 6) & 0x3F));
+		out += (char) (0x80 | (code & 0x3F));
+	} else {
+		out += (char) (0xF0 | (code >> 18));
+		out += (char) (0x80 | ((code >> 12) & 0x3F));
+		out += (char) (0x80 | ((code >> 6) & 0x3F));
+		out += (char) (0x80 | (code & 0x3F));
+	}
+}
+
+/* Gramática de los números: -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)? */
+static bool json_number(const std::string &token) {
+	std::size_t i = 0;
+	std::size_t size = token.length();
+
+	if (i < size && token[i] == '-') {
+		i++;
+	}
+	if (i < size && token[i] == '0') {
+		i++;
+	} else if (i < size && token[i] >= '1' && token[i] <= '9') {
+		while (i < size && token[i] >= '0' && token[i] <= '9') {
+			i++;
+		}
+	} else {
+		return false;
+	}
+
+	if (i < size && token[i] == '.') {
+		std::size_t start = ++i;
+		while (i < size && token[i] >= '0' && token[i] <= '9') {
+			i++;
+		}
+		if (i == start) {
+			return false;
+		}
+	}
+
+	if (i < size && (token[i] == 'e' || token[i] == 'E')) {
+		i++;
+		if (i < size && (token[i] == '+' || token[i] == '-')) {
+			i++;
+		}
+		std::size_t start = i;
+		while (i < size && token[i] >= '0' && token[i] <= '9') {
+			i++;
+		}
+		if (i == start) {
+			return false;
+		}
+	}
+
+	return i == size;
+}
+
+bool JsonReader::after_value() {
+	state = stack.empty() ? STATE_DONE : STATE_NEXT;
+
+	return true;
+}
+
+/* Comienza un valor cuyo primer carácter es c. */
+bool JsonReader::value(char c) {
+	switch (c) {
+	case '{':
+	case '[':
+		if (stack.size() >= FIRMADOR_JSON_DEPTH) {
+			return false;
+		}
+		stack.push_back(c);
+		if (c == '{') {
+			state = STATE_KEY_OR_END;
+			return handler.StartObject();
+		}
+		state = STATE_VALUE_OR_END;
+		return handler.StartArray();
+	case '"':
+		token.clear();
+		key = false;
+		state = STATE_STRING;
+		return true;
+	case 't':
+	case 'f':
+	case 'n':
+		token.assign(1, c);
+		state = STATE_LITERAL;
+		return true;
+	default:
+		if (c == '-' || (c >= '0' && c <= '9')) {
+			token.assign(1, c);
+			state = STATE_NUMBER;
+			return true;
+		}
+		return false;
+	}
+}
+
+bool JsonReader::close(char c) {
+	if (stack.empty() || (c == '}' && stack.back() != '{')
+		|| (c == ']' && stack.back() != '[')) {
+		return false;
+	}
+	stack.pop_back();
+	if (!(c == '}' ? handler.EndObject() : handler.EndArray())) {
+		return false;
+	}
+
+	return after_value();
+}
+
+bool JsonReader::string_end() {
+	if (surrogate != 0) {
+		return false;
+	}
+
+	if (key) {
+		state = STATE_COLON;
+		return handler.Key(token.c_str(), token.length());
+	}
+	if (!handler.String(token.c_str(), token.length())) {
+		return false;
+	}
+
+	return after_value();
+}
+
+bool JsonReader::scalar_end() {
+	if (state == STATE_LITERAL && token != "true" && token != "false"
+		&& token != "null") {
+		return false;
+	}
+	if (state == STATE_NUMBER && !json_number(token)) {
+		return false;
+	}
+	if (!handler.Scalar(token.c_str(), token.length())) {
+		return false;
+	}
+
+	return after_value();
+}
+
+/* Un \uXXXX completo; los pares suplentes se combinan en un solo código. */
+bool JsonReader::unicode_end() {
+	state = STATE_STRING;
+
+	if (unicode >= 0xD800 && unicode <= 0xDBFF) {
+		if (surrogate != 0) {
+			return false;
+		}
+		surrogate = unicode;
+		return true;
+	}
+
+	if (unicode >= 0xDC00 && unicode <= 0xDFFF) {
+		if (surrogate == 0) {
+			return false;
+		}
+		json_utf8(token, 0x10000 + ((surrogate - 0xD800) << 10)
+			+ (unicode - 0xDC00));
+		surrogate = 0;
+		return true;
+	}
+
+	if (surrogate != 0) {
+		return false;
+	}
+	json_utf8(token, unicode);
+
+	return true;
+}
+
+bool JsonReader::feed(const char *data, std::size_t size) {
+	std::size_t i = 0;
+
+	while (i < size && state != STATE_ERROR) {
+		char c = data[i];
+		bool ok = true;
+
+		switch (state) {
+		case STATE_STRING:
+			if (c == '"') {
+				i++;
+				ok = string_end();
+			} else if (c == '\\') {
+				i++;
+				state = STATE_ESCAPE;
+			} else if ((unsigned char) c < 0x20 || surrogate != 0) {
+				ok = false;
+			} else {
+				/* Copia de una vez el tramo sin escapes. */
+				std::size_t j = i;
+				while (j < size && data[j] != '"'
+					&& data[j] != '\\'
+					&& (unsigned char) data[j] >= 0x20) {
+					j++;
+				}
+				token.append(data + i, j - i);
+				i = j;
+			}
+			break;
+		case STATE_ESCAPE:
+			i++;
+			state = STATE_STRING;
+			if (surrogate != 0 && c != 'u') {
+				ok = false;
+				break;
+			}
+			switch (c) {
+			case '"': token += '"'; break;
+			case '\\': token += '\\'; break;
+			case '/': token += '/'; break;
+			case 'b': token += '\b'; break;
+			case 'f': token += '\f'; break;
+			case 'n': token += '\n'; break;
+			case 'r': token += '\r'; break;
+			case 't': token += '\t'; break;
+			case 'u':
+				unicode = 0;
+				unicode_digits = 0;
+				state = STATE_UNICODE;
+				break;
+			default:
+				ok = false;
+			}
+			break;
+		case STATE_UNICODE: {
+			int digit = json_hex(c);
+			i++;
+			if (digit < 0) {
+				ok = false;
+				break;
+			}
+			unicode = (unicode << 4) | digit;
+			if (++unicode_digits == 4) {
+				ok = unicode_end();
+			}
+			break;
+		}
+		case STATE_LITERAL:
+			if (c >= 'a' && c <= 'z') {
+				token += c;
+				i++;
+			} else {
+				/* El carácter se vuelve a procesar después. */
+				ok = scalar_end();
+			}
+			break;
+		case STATE_NUMBER:
+			if ((c >= '0' && c <= '9') || c == '.' || c == 'e'
+				|| c == 'E' || c == '+' || c == '-') {
+				token += c;
+				i++;
+			} else {
+				ok = scalar_end();
+			}
+			break;
+		default:
+			i++;
+			if (json_space(c)) {
+				break;
+			}
+
+			switch (state) {
+			case STATE_VALUE:
+				ok = value(c);
+				break;
+			case STATE_VALUE_OR_END:
+				ok = c == ']' ? close(c) : value(c);
+				break;
+			case STATE_KEY_OR_END:
+			case STATE_KEY:
+				if (state == STATE_KEY_OR_END && c == '}') {
+					ok = close(c);
+					break;
+				}
+				ok = c == '"';
+				token.clear();
+				key = true;
+				state = STATE_STRING;
+				break;
+			case STATE_COLON:
+				ok = c == ':';
+				state = STATE_VALUE;
+				break;
+			case STATE_NEXT:
+				if (c == ',') {
+					state = stack.back() == '{' ? STATE_KEY
+						: STATE_VALUE;
+				} else {
+					ok = close(c);
+				}
+				break;
+			default:
+				ok = false;
+			}
+		}
+
+		if (!ok) {
+			state = STATE_ERROR;
+		}
+	}
+
+	return state != STATE_ERROR;
+}
+
+/* Indica si el documento recibido está completo y es válido. */
+bool JsonReader::finish() {
+	if ((state == STATE_NUMBER || state == STATE_LITERAL)
+		&& stack.empty() && !scalar_end()) {
+		state = STATE_ERROR;
+	}
+
+	return state == STATE_DONE;
+}
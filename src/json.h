@@ -0,0 +1,94 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef FIRMADOR_JSON_H
+#define FIRMADOR_JSON_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#define FIRMADOR_JSON_DEPTH 16
+
+/*
+ * Eventos del analizador, con los mismos nombres que los de RapidJSON. Los
+ * números y los literales true, false y null se entregan sin interpretar.
+ * Devolver false detiene el análisis.
+ */
+class JsonHandler {
+public:
+	virtual ~JsonHandler() {}
+
+	virtual bool StartObject() = 0;
+	virtual bool EndObject() = 0;
+	virtual bool StartArray() = 0;
+	virtual bool EndArray() = 0;
+	virtual bool Key(const char *str, std::size_t length) = 0;
+	virtual bool String(const char *str, std::size_t length) = 0;
+	virtual bool Scalar(const char *str, std::size_t length) = 0;
+};
+
+/*
+ * Analizador JSON incremental: recibe el documento por trozos de cualquier
+ * tamaño, tal como llegan de libmicrohttpd, sin necesitar el documento
+ * completo en memoria. El Reader de RapidJSON no puede reanudar un elemento
+ * partido entre dos trozos.
+ */
+class JsonReader {
+public:
+	explicit JsonReader(JsonHandler &handler);
+
+	bool feed(const char *data, std::size_t size);
+	bool finish();
+
+private:
+	enum state_t {
+		STATE_VALUE,
+		STATE_VALUE_OR_END,
+		STATE_KEY,
+		STATE_KEY_OR_END,
+		STATE_COLON,
+		STATE_NEXT,
+		STATE_STRING,
+		STATE_ESCAPE,
+		STATE_UNICODE,
+		STATE_LITERAL,
+		STATE_NUMBER,
+		STATE_DONE,
+		STATE_ERROR
+	};
+
+	bool value(char c);
+	bool close(char c);
+	bool after_value();
+	bool string_end();
+	bool scalar_end();
+	bool unicode_end();
+
+	JsonHandler &handler;
+	state_t state;
+	std::vector<char> stack;
+	std::string token;
+	bool key;
+	unsigned int unicode;
+	unsigned int unicode_digits;
+	unsigned int surrogate;
+};
+
+#endif
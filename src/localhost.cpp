@@ -0,0 +1,487 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "localhost.h"
+#include "file.h"
+#include "tls.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <mutex>
+#include <thread>
+
+#include <gnutls/crypto.h>
+#include <gnutls/x509.h>
+
+#ifdef _WIN32
+# define FIRMADOR_LOCALHOST_SEPARATOR "\\"
+#else
+# define FIRMADOR_LOCALHOST_SEPARATOR "/"
+#endif
+
+/*
+ * CA propia del usuario, que este instala como raíz de confianza, y
+ * certificado de localhost firmado por ella. Ambos usan ECDSA P-256, cuyas
+ * claves se generan en milisegundos, y se guardan en el directorio de datos
+ * del usuario. En los arranques siguientes solo se proyectan en memoria el
+ * certificado y la clave de localhost; la clave de la CA se lee únicamente
+ * para renovar, cosa que hace un hilo antes de que caduque.
+ */
+static std::string localhost_directory;
+static std::time_t localhost_expiration;
+
+static std::thread localhost_thread;
+static std::mutex localhost_mutex;
+static std::condition_variable localhost_condition;
+static bool localhost_stopping;
+
+static std::string localhost_path(const char *name) {
+	return localhost_directory + FIRMADOR_LOCALHOST_SEPARATOR + name;
+}
+
+static int localhost_read_crt(const std::string &path,
+	gnutls_x509_crt_t *crt) {
+
+	FileMapping file(path);
+	if (!file.valid()) {
+		return GNUTLS_E_FILE_ERROR;
+	}
+
+	gnutls_datum_t data = {
+		const_cast<unsigned char *>(file.data()),
+		(unsigned int) file.size()
+	};
+
+	int ret = gnutls_x509_crt_init(crt);
+	if (ret < GNUTLS_E_SUCCESS) {
+		return ret;
+	}
+
+	ret = gnutls_x509_crt_import(*crt, &data, GNUTLS_X509_FMT_PEM);
+	if (ret < GNUTLS_E_SUCCESS) {
+		gnutls_x509_crt_deinit(*crt);
+	}
+
+	return ret;
+}
+
+static int localhost_read_key(const std::string &path,
+	gnutls_x509_privkey_t *key) {
+
+	FileMapping file(path);
+	if (!file.valid()) {
+		return GNUTLS_E_FILE_ERROR;
+	}
+
+	gnutls_datum_t data = {
+		const_cast<unsigned char *>(file.data()),
+		(unsigned int) file.size()
+	};
+
+	int ret = gnutls_x509_privkey_init(key);
+	if (ret < GNUTLS_E_SUCCESS) {
+		return ret;
+	}
+
+	ret = gnutls_x509_privkey_import(*key, &data, GNUTLS_X509_FMT_PEM);
+	if (ret < GNUTLS_E_SUCCESS) {
+		gnutls_x509_privkey_deinit(*key);
+	}
+
+	return ret;
+}
+
+static int localhost_write(const char *name, const gnutls_datum_t &data) {
+	if (file_write(localhost_path(name), data.data, data.size) != 0) {
+		return GNUTLS_E_FILE_ERROR;
+	}
+
+	return GNUTLS_E_SUCCESS;
+}
+
+static int localhost_write_crt(const char *name, gnutls_x509_crt_t crt) {
+	gnutls_datum_t data;
+	int ret = gnutls_x509_crt_export2(crt, GNUTLS_X509_FMT_PEM, &data);
+	if (ret < GNUTLS_E_SUCCESS) {
+		return ret;
+	}
+
+	ret = localhost_write(name, data);
+	gnutls_free(data.data);
+
+	return ret;
+}
+
+static int localhost_write_key(const char *name, gnutls_x509_privkey_t key) {
+	gnutls_datum_t data;
+	int ret = gnutls_x509_privkey_export2(key, GNUTLS_X509_FMT_PEM, &data);
+	if (ret < GNUTLS_E_SUCCESS) {
+		return ret;
+	}
+
+	ret = localhost_write(name, data);
+	gnutls_memset(data.data, 0, data.size);
+	gnutls_free(data.data);
+
+	return ret;
+}
+
+/* Campos comunes: clave nueva, número de serie aleatorio y validez. */
+static int localhost_prepare(gnutls_x509_crt_t crt, gnutls_x509_privkey_t key,
+	const char *dn, unsigned int days) {
+
+	int ret = gnutls_x509_privkey_generate(key, GNUTLS_PK_ECDSA,
+		GNUTLS_CURVE_TO_BITS(GNUTLS_ECC_CURVE_SECP256R1), 0);
+	if (ret < GNUTLS_E_SUCCESS) {
+		return ret;
+	}
+
+	unsigned char serial[16];
+	ret = gnutls_rnd(GNUTLS_RND_NONCE, serial, sizeof(serial));
+	if (ret < GNUTLS_E_SUCCESS) {
+		return ret;
+	}
+	serial[0] &= 0x7f;
+
+	/* Una hora de margen por si el reloj del navegador va atrasado. */
+	std::time_t now = std::time(NULL);
+	unsigned char id[64];
+	std::size_t id_size = sizeof(id);
+	const char *error;
+
+	if ((ret = gnutls_x509_crt_set_version(crt, 3)) < GNUTLS_E_SUCCESS
+		|| (ret = gnutls_x509_crt_set_serial(crt, serial,
+			sizeof(serial))) < GNUTLS_E_SUCCESS
+		|| (ret = gnutls_x509_crt_set_activation_time(crt,
+			now - 3600)) < GNUTLS_E_SUCCESS
+		|| (ret = gnutls_x509_crt_set_expiration_time(crt,
+			now + days * 86400)) < GNUTLS_E_SUCCESS
+		|| (ret = gnutls_x509_crt_set_dn(crt, dn, &error))
+			< GNUTLS_E_SUCCESS
+		|| (ret = gnutls_x509_crt_set_key(crt, key))
+			< GNUTLS_E_SUCCESS
+		|| (ret = gnutls_x509_crt_get_key_id(crt, 0, id, &id_size))
+			< GNUTLS_E_SUCCESS) {
+		return ret;
+	}
+
+	return gnutls_x509_crt_set_subject_key_id(crt, id, id_size);
+}
+
+/*
+ * La CA solo puede emitir para localhost y las direcciones de bucle local,
+ * así que su clave no sirve para suplantar otros sitios.
+ */
+static int localhost_constraints(gnutls_x509_crt_t crt) {
+	static const unsigned char ipv4[] = {
+		127, 0, 0, 0, 255, 0, 0, 0
+	};
+	static const unsigned char ipv6[] = {
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1,
+		255, 255, 255, 255, 255, 255, 255, 255,
+		255, 255, 255, 255, 255, 255, 255, 255
+	};
+	gnutls_datum_t dns = { (unsigned char *) "localhost", 9 };
+	gnutls_datum_t ip4 = { (unsigned char *) ipv4, sizeof(ipv4) };
+	gnutls_datum_t ip6 = { (unsigned char *) ipv6, sizeof(ipv6) };
+
+	gnutls_x509_name_constraints_t constraints;
+	int ret = gnutls_x509_name_constraints_init(&constraints);
+	if (ret < GNUTLS_E_SUCCESS) {
+		return ret;
+	}
+
+	if ((ret = gnutls_x509_name_constraints_add_permitted(constraints,
+			GNUTLS_SAN_DNSNAME, &dns)) == GNUTLS_E_SUCCESS
+		&& (ret = gnutls_x509_name_constraints_add_permitted(
+			constraints, GNUTLS_SAN_IPADDRESS, &ip4))
+			== GNUTLS_E_SUCCESS
+		&& (ret = gnutls_x509_name_constraints_add_permitted(
+			constraints, GNUTLS_SAN_IPADDRESS, &ip6))
+			== GNUTLS_E_SUCCESS) {
+		ret = gnutls_x509_crt_set_name_constraints(crt, constraints, 1);
+	}
+	gnutls_x509_name_constraints_deinit(constraints);
+
+	return ret;
+}
+
+static int localhost_generate_ca(gnutls_x509_crt_t ca,
+	gnutls_x509_privkey_t ca_key) {
+
+	int ret = localhost_prepare(ca, ca_key,
+		"CN=Firmador CA local,O=Firmador", FIRMADOR_LOCALHOST_CA_DAYS);
+	if (ret < GNUTLS_E_SUCCESS
+		|| (ret = gnutls_x509_crt_set_basic_constraints(ca, 1, 0))
+			< GNUTLS_E_SUCCESS
+		|| (ret = gnutls_x509_crt_set_key_usage(ca,
+			GNUTLS_KEY_KEY_CERT_SIGN | GNUTLS_KEY_CRL_SIGN))
+			< GNUTLS_E_SUCCESS
+		|| (ret = localhost_constraints(ca)) < GNUTLS_E_SUCCESS
+		|| (ret = gnutls_x509_crt_sign2(ca, ca, ca_key,
+			GNUTLS_DIG_SHA256, 0)) < GNUTLS_E_SUCCESS) {
+		return ret;
+	}
+
+	/* La clave primero: una CA sin clave no permitiría renovar. */
+	ret = localhost_write_key("ca.key", ca_key);
+	if (ret == GNUTLS_E_SUCCESS) {
+		ret = localhost_write_crt("ca.pem", ca);
+	}
+
+	return ret;
+}
+
+/* Genera, guarda y pone en servicio un certificado de localhost nuevo. */
+static int localhost_generate(gnutls_x509_crt_t ca,
+	gnutls_x509_privkey_t ca_key) {
+
+	static const unsigned char ipv4[] = { 127, 0, 0, 1 };
+	static const unsigned char ipv6[] = {
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1
+	};
+
+	gnutls_x509_crt_t crt;
+	int ret = gnutls_x509_crt_init(&crt);
+	if (ret < GNUTLS_E_SUCCESS) {
+		return ret;
+	}
+
+	gnutls_x509_privkey_t key;
+	ret = gnutls_x509_privkey_init(&key);
+	if (ret < GNUTLS_E_SUCCESS) {
+		gnutls_x509_crt_deinit(crt);
+		return ret;
+	}
+
+	unsigned char authority[64];
+	std::size_t authority_size = sizeof(authority);
+	gnutls_datum_t certificate = { NULL, 0 };
+	gnutls_datum_t private_key = { NULL, 0 };
+
+	/* No puede durar más que la CA que lo firma. */
+	std::time_t ca_expiration = gnutls_x509_crt_get_expiration_time(ca);
+
+	if ((ret = localhost_prepare(crt, key, "CN=localhost",
+			FIRMADOR_LOCALHOST_DAYS)) < GNUTLS_E_SUCCESS
+		|| (gnutls_x509_crt_get_expiration_time(crt) > ca_expiration
+		&& (ret = gnutls_x509_crt_set_expiration_time(crt,
+			ca_expiration)) < GNUTLS_E_SUCCESS)
+		|| (ret = gnutls_x509_crt_set_basic_constraints(crt, 0, -1))
+			< GNUTLS_E_SUCCESS
+		|| (ret = gnutls_x509_crt_set_key_usage(crt,
+			GNUTLS_KEY_DIGITAL_SIGNATURE)) < GNUTLS_E_SUCCESS
+		|| (ret = gnutls_x509_crt_set_key_purpose_oid(crt,
+			GNUTLS_KP_TLS_WWW_SERVER, 0)) < GNUTLS_E_SUCCESS
+		|| (ret = gnutls_x509_crt_set_subject_alt_name(crt,
+			GNUTLS_SAN_DNSNAME, "localhost", 9,
+			GNUTLS_FSAN_APPEND)) < GNUTLS_E_SUCCESS
+		|| (ret = gnutls_x509_crt_set_subject_alt_name(crt,
+			GNUTLS_SAN_IPADDRESS, ipv4, sizeof(ipv4),
+			GNUTLS_FSAN_APPEND)) < GNUTLS_E_SUCCESS
+		|| (ret = gnutls_x509_crt_set_subject_alt_name(crt,
+			GNUTLS_SAN_IPADDRESS, ipv6, sizeof(ipv6),
+			GNUTLS_FSAN_APPEND)) < GNUTLS_E_SUCCESS
+		|| (ret = gnutls_x509_crt_get_subject_key_id(ca, authority,
+			&authority_size, NULL)) < GNUTLS_E_SUCCESS
+		|| (ret = gnutls_x509_crt_set_authority_key_id(crt, authority,
+			authority_size)) < GNUTLS_E_SUCCESS
+		|| (ret = gnutls_x509_crt_sign2(crt, ca, ca_key,
+			GNUTLS_DIG_SHA256, 0)) < GNUTLS_E_SUCCESS
+		|| (ret = gnutls_x509_crt_export2(crt, GNUTLS_X509_FMT_PEM,
+			&certificate)) < GNUTLS_E_SUCCESS
+		|| (ret = gnutls_x509_privkey_export2(key, GNUTLS_X509_FMT_PEM,
+			&private_key)) < GNUTLS_E_SUCCESS
+		|| (ret = localhost_write("localhost.key", private_key))
+			< GNUTLS_E_SUCCESS
+		|| (ret = localhost_write("localhost.pem", certificate))
+			< GNUTLS_E_SUCCESS
+		|| (ret = tls_credentials(certificate, private_key))
+			< GNUTLS_E_SUCCESS) {
+		/* Se libera abajo. */
+	} else {
+		localhost_expiration = gnutls_x509_crt_get_expiration_time(crt);
+	}
+
+	gnutls_free(certificate.data);
+	if (private_key.data != NULL) {
+		gnutls_memset(private_key.data, 0, private_key.size);
+		gnutls_free(private_key.data);
+	}
+	gnutls_x509_privkey_deinit(key);
+	gnutls_x509_crt_deinit(crt);
+
+	return ret;
+}
+
+static bool localhost_expiring(std::time_t expiration) {
+	return expiration - FIRMADOR_LOCALHOST_RENEW_DAYS * 86400
+		<= std::time(NULL);
+}
+
+/*
+ * Sin CA utilizable se crea una nueva, que el usuario tendrá que volver a
+ * instalar como raíz de confianza.
+ */
+static int localhost_create() {
+	gnutls_x509_crt_t ca;
+	int ret = gnutls_x509_crt_init(&ca);
+	if (ret < GNUTLS_E_SUCCESS) {
+		return ret;
+	}
+
+	gnutls_x509_privkey_t ca_key;
+	ret = gnutls_x509_privkey_init(&ca_key);
+	if (ret < GNUTLS_E_SUCCESS) {
+		gnutls_x509_crt_deinit(ca);
+		return ret;
+	}
+
+	ret = localhost_generate_ca(ca, ca_key);
+	if (ret == GNUTLS_E_SUCCESS) {
+		ret = localhost_generate(ca, ca_key);
+	}
+	gnutls_x509_privkey_deinit(ca_key);
+	gnutls_x509_crt_deinit(ca);
+
+	return ret;
+}
+
+/*
+ * Si la CA guardada sigue vigente basta renovar localhost, y su clave solo
+ * se lee para esto. Si falta o está por caducar se crea otra.
+ */
+static int localhost_renew() {
+	gnutls_x509_crt_t ca;
+	int ret = localhost_read_crt(localhost_path("ca.pem"), &ca);
+	if (ret == GNUTLS_E_SUCCESS) {
+		ret = GNUTLS_E_EXPIRED;
+		gnutls_x509_privkey_t ca_key;
+		if (!localhost_expiring(gnutls_x509_crt_get_expiration_time(ca))
+			&& (ret = localhost_read_key(localhost_path("ca.key"),
+				&ca_key)) == GNUTLS_E_SUCCESS) {
+			ret = localhost_generate(ca, ca_key);
+			gnutls_x509_privkey_deinit(ca_key);
+		}
+		gnutls_x509_crt_deinit(ca);
+		if (ret == GNUTLS_E_SUCCESS) {
+			return ret;
+		}
+	}
+
+	return localhost_create();
+}
+
+/*
+ * Carga el certificado de localhost guardado si lo firmó la CA actual y no
+ * está por caducar, proyectándolo en memoria sin copiarlo.
+ */
+static int localhost_reuse(gnutls_x509_crt_t ca) {
+	gnutls_x509_crt_t crt;
+	int ret = localhost_read_crt(localhost_path("localhost.pem"), &crt);
+	if (ret < GNUTLS_E_SUCCESS) {
+		return ret;
+	}
+
+	unsigned int status;
+	std::time_t expiration = gnutls_x509_crt_get_expiration_time(crt);
+	ret = gnutls_x509_crt_verify(crt, &ca, 1, 0, &status);
+	gnutls_x509_crt_deinit(crt);
+	if (ret < GNUTLS_E_SUCCESS) {
+		return ret;
+	}
+	if (status != 0 || localhost_expiring(expiration)) {
+		return GNUTLS_E_EXPIRED;
+	}
+
+	ret = tls_files(localhost_path("localhost.pem"),
+		localhost_path("localhost.key"));
+	if (ret == GNUTLS_E_SUCCESS) {
+		localhost_expiration = expiration;
+	}
+
+	return ret;
+}
+
+int localhost_load(const std::string &directory) {
+	localhost_directory = directory;
+	if (file_directory(directory) != 0) {
+		return GNUTLS_E_FILE_ERROR;
+	}
+
+	gnutls_x509_crt_t ca;
+	int ret = localhost_read_crt(localhost_path("ca.pem"), &ca);
+	if (ret == GNUTLS_E_SUCCESS) {
+		ret = localhost_expiring(
+			gnutls_x509_crt_get_expiration_time(ca))
+			? GNUTLS_E_EXPIRED : localhost_reuse(ca);
+		gnutls_x509_crt_deinit(ca);
+		if (ret == GNUTLS_E_SUCCESS) {
+			return ret;
+		}
+	}
+
+	return localhost_renew();
+}
+
+/*
+ * Espera a que falten FIRMADOR_LOCALHOST_RENEW_DAYS para caducar, en tramos
+ * de una hora para no depender de un reloj que se detiene al suspender. Si
+ * renovar falla se reintenta a la hora siguiente.
+ */
+static void localhost_run() {
+	for (;;) {
+		if (localhost_expiring(localhost_expiration)) {
+			localhost_renew();
+		}
+
+		std::time_t wait = 3600;
+		if (!localhost_expiring(localhost_expiration)) {
+			wait = std::min(wait, localhost_expiration
+				- FIRMADOR_LOCALHOST_RENEW_DAYS * 86400
+				- std::time(NULL));
+		}
+
+		std::unique_lock<std::mutex> lock(localhost_mutex);
+		localhost_condition.wait_for(lock, std::chrono::seconds(wait),
+			[]() { return localhost_stopping; });
+		if (localhost_stopping) {
+			return;
+		}
+	}
+}
+
+void localhost_start() {
+	localhost_stopping = false;
+	localhost_thread = std::thread(localhost_run);
+}
+
+void localhost_stop() {
+	{
+		std::lock_guard<std::mutex> lock(localhost_mutex);
+		localhost_stopping = true;
+	}
+	localhost_condition.notify_all();
+
+	if (localhost_thread.joinable()) {
+		localhost_thread.join();
+	}
+}
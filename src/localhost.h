@@ -0,0 +1,35 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef FIRMADOR_LOCALHOST_H
+#define FIRMADOR_LOCALHOST_H
+
+#include <string>
+
+/* Validez en días de la CA local y del certificado de localhost. */
+#define FIRMADOR_LOCALHOST_CA_DAYS 3650
+#define FIRMADOR_LOCALHOST_DAYS 90
+/* Días antes de caducar en que se renueva el certificado de localhost. */
+#define FIRMADOR_LOCALHOST_RENEW_DAYS 30
+
+int localhost_load(const std::string &directory);
+void localhost_start();
+void localhost_stop();
+
+#endif
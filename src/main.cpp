@@ -0,0 +1,130 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "config.h"
+#include "request.h"
+#include "service.h"
+#ifdef FIRMADOR_GUI
+# include "firmador.h"
+#endif
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+
+#ifndef _WIN32
+# include <csignal>
+# include <pthread.h>
+# include <thread>
+#else
+# include <windows.h>
+#endif
+
+static std::mutex main_mutex;
+static std::condition_variable main_condition;
+static bool main_stopping = false;
+
+static void main_stop() {
+	{
+		std::lock_guard<std::mutex> lock(main_mutex);
+		main_stopping = true;
+	}
+	main_condition.notify_all();
+}
+
+#ifndef _WIN32
+static void main_signals(sigset_t signals) {
+	int signal;
+	sigwait(&signals, &signal);
+	main_stop();
+}
+#else
+static BOOL WINAPI main_console(DWORD type) {
+	(void) type;
+
+	main_stop();
+
+	return TRUE;
+}
+#endif
+
+/*
+ * Sin wxWidgets: los errores van a la salida de error y el servicio corre
+ * hasta recibir SIGINT o SIGTERM, o Ctrl+C en la consola de Windows. Con
+ * FIRMADOR_IDLE_TIMEOUT también termina tras ese tiempo sin conexiones; con
+ * activación por socket systemd lo vuelve a arrancar con la siguiente.
+ */
+static int main_headless() {
+#ifndef _WIN32
+	/* Se bloquean antes de crear hilos para que todos los hereden. */
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &signals, NULL);
+#endif
+
+	std::string title;
+	std::string message;
+	if (!service_start(title, message)) {
+		fprintf(stderr, "%s: %s\n", title.c_str(), message.c_str());
+		return 1;
+	}
+
+#ifndef _WIN32
+	std::thread(main_signals, signals).detach();
+#else
+	SetConsoleCtrlHandler(main_console, TRUE);
+#endif
+
+	unsigned long idle = config().idle_timeout;
+	{
+		std::unique_lock<std::mutex> lock(main_mutex);
+		while (!main_stopping) {
+			if (idle == 0) {
+				main_condition.wait(lock);
+				continue;
+			}
+
+			main_condition.wait_for(lock, std::chrono::seconds(1));
+			if (request_idle(idle)) {
+				break;
+			}
+		}
+	}
+
+	service_stop();
+
+	return 0;
+}
+
+int main(int argc, char **argv) {
+#ifdef FIRMADOR_GUI
+	if (!config().headless) {
+		return wxEntry(argc, argv);
+	}
+#else
+	(void) argc;
+	(void) argv;
+#endif
+
+	return main_headless();
+}
@@ -0,0 +1,321 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "metrics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+/* Límites de los intervalos en microsegundos, de 100 µs a 30 s. */
+static const std::uint64_t metrics_buckets[] = {
+	100, 250, 500, 1000, 2500, 5000, 10000, 25000, 100000, 250000,
+	1000000, 5000000, 30000000
+};
+static const std::size_t metrics_buckets_size =
+	sizeof(metrics_buckets) / sizeof(metrics_buckets[0]);
+
+/* Un histograma guarda cada intervalo, el de +Inf y la suma. */
+static const std::size_t metrics_histogram_slots = metrics_buckets_size + 2;
+
+static_assert(metrics_histogram_slots == FIRMADOR_METRICS_HISTOGRAM_SLOTS,
+	"FIRMADOR_METRICS_HISTOGRAM_SLOTS no coincide con los intervalos");
+
+/*
+ * Valores de un hilo. Solo los escribe su hilo, así que basta leer y
+ * escribir sin más sincronización que la atomicidad de cada valor. Se
+ * reservan los valores registrados al crearla y crece si se registran más.
+ */
+struct metrics_shard_t {
+	std::size_t size;
+	std::atomic<std::uint64_t> *values;
+
+	explicit metrics_shard_t(std::size_t size) : size(size),
+		values(new std::atomic<std::uint64_t>[size]) {
+
+		for (std::size_t i = 0; i < size; i++) {
+			values[i].store(0, std::memory_order_relaxed);
+		}
+	}
+	~metrics_shard_t() {
+		delete[] values;
+	}
+
+private:
+	metrics_shard_t(const metrics_shard_t &);
+	metrics_shard_t &operator=(const metrics_shard_t &);
+};
+
+struct metrics_entry_t {
+	std::string name;
+	std::string labels;
+	std::string help;
+	bool histogram;
+	std::size_t slot;
+};
+
+/*
+ * Las métricas se registran al construirse y los hilos al escribir por
+ * primera vez; el cerrojo solo se toma entonces, al terminar un hilo y al
+ * consultar. Lo que sumaron los hilos terminados se conserva en retired.
+ */
+struct metrics_registry_t {
+	std::mutex mutex;
+	std::vector<metrics_entry_t> entries;
+	std::size_t slots;
+	std::vector<metrics_shard_t *> shards;
+	std::vector<std::uint64_t> retired;
+
+	metrics_registry_t() : slots(0) {}
+};
+
+/*
+ * Nunca se destruye: las métricas estáticas de otros ficheros y los hilos que
+ * terminan tras main la pueden usar en cualquier orden.
+ */
+static metrics_registry_t &metrics_registry() {
+	static metrics_registry_t *registry = new metrics_registry_t();
+
+	return *registry;
+}
+
+static std::size_t metrics_register(const std::string &name,
+	const std::string &labels, const std::string &help, bool histogram) {
+
+	metrics_registry_t &registry = metrics_registry();
+	std::size_t size = histogram ? metrics_histogram_slots : 1;
+	std::lock_guard<std::mutex> lock(registry.mutex);
+
+	/* Pasarse es un error de programación, no algo que callar. */
+	if (registry.slots + size > FIRMADOR_METRICS_SLOTS) {
+		throw std::length_error("sin espacio para la métrica " + name
+			+ "{" + labels + "}");
+	}
+
+	metrics_entry_t entry;
+	entry.name = name;
+	entry.labels = labels;
+	entry.help = help;
+	entry.histogram = histogram;
+	entry.slot = registry.slots;
+	registry.entries.push_back(entry);
+	registry.slots += size;
+	registry.retired.resize(registry.slots, 0);
+
+	return entry.slot;
+}
+
+static void metrics_retire(metrics_shard_t *shard) {
+	metrics_registry_t &registry = metrics_registry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+
+	for (std::size_t i = 0; i < shard->size; i++) {
+		registry.retired[i] += shard->values[i].load(
+			std::memory_order_relaxed);
+	}
+	registry.shards.erase(std::remove(registry.shards.begin(),
+		registry.shards.end(), shard), registry.shards.end());
+	delete shard;
+}
+
+/* Al terminar el hilo pasa sus valores a retired. */
+struct metrics_reaper_t {
+	metrics_shard_t *shard;
+
+	~metrics_reaper_t() {
+		if (shard != NULL) {
+			metrics_retire(shard);
+		}
+	}
+};
+
+static thread_local metrics_shard_t *metrics_local = NULL;
+static thread_local metrics_reaper_t metrics_reaper;
+
+static metrics_shard_t *metrics_shard() {
+	if (metrics_local != NULL) {
+		return metrics_local;
+	}
+
+	metrics_shard_t *shard;
+	{
+		metrics_registry_t &registry = metrics_registry();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		shard = new metrics_shard_t(registry.slots);
+		registry.shards.push_back(shard);
+	}
+	metrics_reaper.shard = shard;
+	metrics_local = shard;
+
+	return shard;
+}
+
+/*
+ * Amplía la copia del hilo a lo registrado después de crearla. Solo la
+ * cambia su hilo y bajo el cerrojo, que es el que toma quien consulta.
+ */
+static void metrics_grow(metrics_shard_t *shard) {
+	metrics_registry_t &registry = metrics_registry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	std::atomic<std::uint64_t> *values =
+		new std::atomic<std::uint64_t>[registry.slots];
+
+	for (std::size_t i = 0; i < registry.slots; i++) {
+		values[i].store(i < shard->size ? shard->values[i].load(
+			std::memory_order_relaxed) : 0,
+			std::memory_order_relaxed);
+	}
+	delete[] shard->values;
+	shard->values = values;
+	shard->size = registry.slots;
+}
+
+static inline void metrics_add(std::size_t slot, std::uint64_t value) {
+	metrics_shard_t *shard = metrics_shard();
+	if (slot >= shard->size) {
+		metrics_grow(shard);
+	}
+
+	std::atomic<std::uint64_t> &target = shard->values[slot];
+	target.store(target.load(std::memory_order_relaxed) + value,
+		std::memory_order_relaxed);
+}
+
+MetricCounter::MetricCounter(const std::string &name,
+	const std::string &labels, const std::string &help) :
+	slot(metrics_register(name, labels, help, false)) {}
+
+void MetricCounter::add(std::uint64_t value) {
+	metrics_add(slot, value);
+}
+
+MetricHistogram::MetricHistogram(const std::string &name,
+	const std::string &labels, const std::string &help) :
+	slot(metrics_register(name, labels, help, true)) {}
+
+void MetricHistogram::observe(std::uint64_t microseconds) {
+	std::size_t bucket = 0;
+	while (bucket < metrics_buckets_size
+		&& microseconds > metrics_buckets[bucket]) {
+		bucket++;
+	}
+
+	metrics_add(slot + bucket, 1);
+	metrics_add(slot + metrics_buckets_size + 1, microseconds);
+}
+
+static bool metrics_order(const metrics_entry_t &a,
+	const metrics_entry_t &b) {
+
+	return a.name != b.name ? a.name < b.name : a.labels < b.labels;
+}
+
+static void metrics_labels(std::ostream &out, const std::string &labels,
+	const char *extra) {
+
+	if (labels.empty() && extra == NULL) {
+		return;
+	}
+
+	out << "{" << labels;
+	if (extra != NULL) {
+		out << (labels.empty() ? "" : ",") << extra;
+	}
+	out << "}";
+}
+
+/* Formato de texto de Prometheus, con los segundos como unidad de tiempo. */
+void metrics_write(std::ostream &out) {
+	metrics_registry_t &registry = metrics_registry();
+	std::vector<std::uint64_t> values;
+	std::vector<metrics_entry_t> entries;
+
+	{
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		values = registry.retired;
+		for (std::size_t j = 0; j < registry.shards.size(); j++) {
+			const metrics_shard_t *shard = registry.shards[j];
+			for (std::size_t i = 0; i < shard->size; i++) {
+				values[i] += shard->values[i].load(
+					std::memory_order_relaxed);
+			}
+		}
+		entries = registry.entries;
+	}
+
+	std::stable_sort(entries.begin(), entries.end(), metrics_order);
+
+	for (std::size_t i = 0; i < entries.size(); i++) {
+		const metrics_entry_t &entry = entries[i];
+
+		if (i == 0 || entries[i - 1].name != entry.name) {
+			out << "# HELP " << entry.name << " " << entry.help
+				<< "\n# TYPE " << entry.name << " "
+				<< (entry.histogram ? "histogram" : "counter")
+				<< "\n";
+		}
+
+		if (!entry.histogram) {
+			out << entry.name;
+			metrics_labels(out, entry.labels, NULL);
+			out << " " << values[entry.slot] << "\n";
+			continue;
+		}
+
+		/* Se omiten las combinaciones de etiquetas aún sin datos. */
+		std::uint64_t total = 0;
+		for (std::size_t j = 0; j <= metrics_buckets_size; j++) {
+			total += values[entry.slot + j];
+		}
+		if (total == 0) {
+			continue;
+		}
+
+		std::uint64_t count = 0;
+		for (std::size_t j = 0; j <= metrics_buckets_size; j++) {
+			count += values[entry.slot + j];
+
+			std::string le = "le=\"+Inf\"";
+			if (j < metrics_buckets_size) {
+				std::ostringstream bound;
+				bound << "le=\"" << metrics_buckets[j] / 1e6
+					<< "\"";
+				le = bound.str();
+			}
+
+			out << entry.name << "_bucket";
+			metrics_labels(out, entry.labels, le.c_str());
+			out << " " << count << "\n";
+		}
+
+		std::ostringstream sum;
+		sum << std::fixed << std::setprecision(6)
+			<< values[entry.slot + metrics_buckets_size + 1] / 1e6;
+
+		out << entry.name << "_sum";
+		metrics_labels(out, entry.labels, NULL);
+		out << " " << sum.str() << "\n" << entry.name << "_count";
+		metrics_labels(out, entry.labels, NULL);
+		out << " " << count << "\n";
+	}
+}
@@ -0,0 +1,99 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef FIRMADOR_METRICS_H
+#define FIRMADOR_METRICS_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/*
+ * Valores que caben en el registro. Registrar más lanza std::length_error;
+ * cada hilo reserva solo los registrados, así que el límite no cuesta memoria.
+ */
+#define FIRMADOR_METRICS_SLOTS 4096
+
+/* Valores de cada histograma: sus 13 intervalos, el de +Inf y la suma. */
+#define FIRMADOR_METRICS_HISTOGRAM_SLOTS 15
+
+/*
+ * Contador acumulado. Cada hilo suma en su propia copia sin instrucciones
+ * atómicas de lectura-modificación-escritura; las copias se juntan al
+ * consultar /metrics.
+ */
+class MetricCounter {
+public:
+	MetricCounter(const std::string &name, const std::string &labels,
+		const std::string &help);
+
+	void add(std::uint64_t value = 1);
+
+private:
+	MetricCounter(const MetricCounter &);
+	MetricCounter &operator=(const MetricCounter &);
+
+	std::size_t slot;
+};
+
+/* Histograma de duraciones con intervalos fijos, en microsegundos. */
+class MetricHistogram {
+public:
+	MetricHistogram(const std::string &name, const std::string &labels,
+		const std::string &help);
+
+	void observe(std::uint64_t microseconds);
+
+private:
+	MetricHistogram(const MetricHistogram &);
+	MetricHistogram &operator=(const MetricHistogram &);
+
+	std::size_t slot;
+};
+
+/* Mide lo que dura el ámbito en que se declara. */
+class MetricTimer {
+public:
+	explicit MetricTimer(MetricHistogram &histogram) :
+		histogram(histogram),
+		start(std::chrono::steady_clock::now()) {}
+	~MetricTimer() {
+		histogram.observe(std::chrono::duration_cast<
+			std::chrono::microseconds>(
+			std::chrono::steady_clock::now() - start).count());
+	}
+
+private:
+	MetricTimer(const MetricTimer &);
+	MetricTimer &operator=(const MetricTimer &);
+
+	MetricHistogram &histogram;
+	std::chrono::steady_clock::time_point start;
+};
+
+/* Histograma común a las llamadas a GnuTLS que llegan al token. */
+#define FIRMADOR_METRICS_PKCS11 "firmador_pkcs11_call_seconds"
+#define FIRMADOR_METRICS_PKCS11_HELP \
+	"Duración de las llamadas PKCS#11 a través de GnuTLS."
+
+void metrics_write(std::ostream &out);
+
+#endif
@@ -0,0 +1,128 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "monitor.h"
+#include "cache.h"
+#include "handle.h"
+#include "metrics.h"
+#include "provider.h"
+#include "session.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gnutls/gnutls.h>
+
+/*
+ * GnuTLS no expone C_WaitForSlotEvent, así que se sondean las ranuras. Tras
+ * un cambio se vuelve a mirar pronto y, mientras no cambie nada, el
+ * intervalo se duplica hasta el máximo.
+ */
+static std::thread monitor_thread;
+static std::mutex monitor_mutex;
+static std::condition_variable monitor_condition;
+static bool monitor_stopping;
+static bool monitor_requested;
+
+static MetricCounter monitor_insertions("firmador_token_insertions_total", "",
+	"Tokens insertados y leídos.");
+static MetricCounter monitor_removals("firmador_token_removals_total", "",
+	"Tokens retirados.");
+
+static void monitor_run() {
+	unsigned int interval = FIRMADOR_MONITOR_INTERVAL_MIN;
+
+	/* Hasta que se piden certificados no se cargan los módulos. */
+	{
+		std::unique_lock<std::mutex> lock(monitor_mutex);
+		monitor_condition.wait(lock, []() {
+			return monitor_stopping || monitor_requested;
+		});
+		if (monitor_stopping) {
+			return;
+		}
+	}
+	provider_load();
+
+	for (;;) {
+		std::size_t inserted;
+		std::vector<std::string> removed;
+		int ret = cache_update(inserted, removed);
+
+		if (ret == GNUTLS_E_SUCCESS
+			&& (inserted != 0 || !removed.empty())) {
+			monitor_insertions.add(inserted);
+			monitor_removals.add(removed.size());
+			interval = FIRMADOR_MONITOR_INTERVAL_MIN;
+
+			/* Sesiones y tokenId no sobreviven a la tarjeta. */
+			for (std::size_t i = 0; i < removed.size(); i++) {
+				handle_invalidate(removed.at(i));
+				session_invalidate(removed.at(i));
+			}
+		} else {
+			interval = std::min(interval * 2,
+				(unsigned int) FIRMADOR_MONITOR_INTERVAL_MAX);
+		}
+
+		session_expire();
+
+		std::unique_lock<std::mutex> lock(monitor_mutex);
+		monitor_condition.wait_for(lock,
+			std::chrono::milliseconds(interval),
+			[]() { return monitor_stopping; });
+		if (monitor_stopping) {
+			return;
+		}
+	}
+}
+
+void monitor_start() {
+	monitor_stopping = false;
+	monitor_requested = false;
+	monitor_thread = std::thread(monitor_run);
+}
+
+void monitor_stop() {
+	{
+		std::lock_guard<std::mutex> lock(monitor_mutex);
+		monitor_stopping = true;
+	}
+	monitor_condition.notify_all();
+
+	if (monitor_thread.joinable()) {
+		monitor_thread.join();
+	}
+}
+
+void monitor_request() {
+	{
+		std::lock_guard<std::mutex> lock(monitor_mutex);
+		if (monitor_requested) {
+			return;
+		}
+		monitor_requested = true;
+	}
+	monitor_condition.notify_all();
+}
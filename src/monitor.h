@@ -0,0 +1,31 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef FIRMADOR_MONITOR_H
+#define FIRMADOR_MONITOR_H
+
+/* Intervalo de sondeo de ranuras en milisegundos. */
+#define FIRMADOR_MONITOR_INTERVAL_MIN 250
+#define FIRMADOR_MONITOR_INTERVAL_MAX 2000
+
+void monitor_start();
+void monitor_stop();
+void monitor_request();
+
+#endif
@@ -18,14 +18,19 @@ You should have received a copy of the GNU General Public License
 along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
 
 #include "pin.h"
+#include "metrics.h"
+#include "prompt.h"
 
-#include <wx/wxprec.h>
-#ifndef WX_PRECOMP
-# include <wx/wx.h>
-#endif
+#include <string>
 
 #include <gnutls/pkcs11.h>
 
+static MetricCounter pin_prompts("firmador_pin_prompts_total", "",
+	"Veces que se ha pedido el PIN.");
+static MetricCounter pin_failures("firmador_pin_failures_total", "",
+	"Peticiones de PIN tras un PIN incorrecto.");
+
+/* Función de PIN de GnuTLS: compone el mensaje y lo pide al usuario. */
 int pin_callback(void *userdata, int attempt, const char *token_url,
 	const char *token_label, unsigned int flags, char *pin,
 	std::size_t pin_max) {
@@ -33,47 +38,27 @@ int pin_callback(void *userdata, int attempt, const char *token_url,
 	(void) userdata;
 	(void) attempt;
 	(void) token_url;
-	wxString warning = wxT("");
+	std::string description;
 
 	if (flags & GNUTLS_PIN_FINAL_TRY) {
-		warning = warning + wxT("ADVERTENCIA: ¡ESTE ES EL ÚLTIMO ")
-			+ wxT("INTENTO ANTES DE BLOQUEAR LA TARJETA!\n\n");
+		description += "ADVERTENCIA: ¡ESTE ES EL ÚLTIMO "
+			"INTENTO ANTES DE BLOQUEAR LA TARJETA!\n\n";
 	}
 
 	if (flags & GNUTLS_PIN_COUNT_LOW) {
-		warning = warning + wxT("AVISO: ¡quedan pocos intentos antes ")
-			+ wxT("de BLOQUEAR la tarjeta!\n\n");
+		description += "AVISO: ¡quedan pocos intentos antes "
+			"de BLOQUEAR la tarjeta!\n\n";
 	}
 
 	if (flags & GNUTLS_PIN_WRONG) {
-		warning = warning + wxT("PIN INCORRECTO\n\n");
+		description += "PIN INCORRECTO\n\n";
+		pin_failures.add();
 	}
 
-	wxPasswordEntryDialog pinDialog(NULL, warning
-		+ wxT("Introducir el PIN de la tarjeta ")
-		+ wxString(token_label, wxConvUTF8) + wxT(":"),
-		wxT("Introducción del PIN"), wxEmptyString,
-		wxTextEntryDialogStyle | wxSTAY_ON_TOP);
-
-	if (pinDialog.ShowModal() == wxID_OK) {
-		if (pinDialog.GetValue().mb_str(wxConvUTF8).data() == NULL
-			|| pinDialog.GetValue().mb_str(wxConvUTF8)
-				.data()[0] == 0) {
-			wxMessageBox(
-				wxString("No se ha introducido ningún valor",
-					wxConvUTF8),
-				wxT("PIN en blanco"));
-			return -1;
-		}
-
-		int len = std::min(pin_max - 1,
-			std::char_traits<char>::length(
-				pinDialog.GetValue().mb_str(wxConvUTF8)));
-		memcpy(pin, pinDialog.GetValue().mb_str(wxConvUTF8), len);
-		pin[len] = 0;
-
-		return 0;
-	} else {
-		return -1;
-	}
+	description = description + "Introducir el PIN de la tarjeta "
+		+ token_label + ":";
+
+	pin_prompts.add();
+
+	return prompt().pin(description, pin, pin_max);
 }
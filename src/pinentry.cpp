@@ -0,0 +1,283 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef _WIN32
+
+#include "pinentry.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <gnutls/gnutls.h>
+
+/* Longitud máxima de una línea del protocolo Assuan. */
+#define FIRMADOR_PINENTRY_LINE 1002
+
+/* Un proceso pinentry durante una petición, con el que se habla Assuan. */
+class PinentrySession {
+public:
+	explicit PinentrySession(const std::string &program);
+	~PinentrySession();
+
+	bool valid() const;
+	bool command(const std::string &line, char *data = NULL,
+		std::size_t data_max = 0);
+
+private:
+	bool response(char *data, std::size_t data_max);
+
+	pid_t child;
+	int input;
+	FILE *output;
+};
+
+PinentrySession::PinentrySession(const std::string &program) : child(-1),
+	input(-1), output(NULL) {
+
+	int to_child[2];
+	int from_child[2];
+
+	if (pipe(to_child) != 0) {
+		return;
+	}
+	if (pipe(from_child) != 0) {
+		close(to_child[0]);
+		close(to_child[1]);
+		return;
+	}
+
+	child = fork();
+	if (child == 0) {
+		dup2(to_child[0], STDIN_FILENO);
+		dup2(from_child[1], STDOUT_FILENO);
+		close(to_child[0]);
+		close(to_child[1]);
+		close(from_child[0]);
+		close(from_child[1]);
+		execlp(program.c_str(), program.c_str(), (char*) NULL);
+		_exit(127);
+	}
+
+	close(to_child[0]);
+	close(from_child[1]);
+	if (child < 0) {
+		close(to_child[1]);
+		close(from_child[0]);
+		return;
+	}
+
+	input = to_child[1];
+	output = fdopen(from_child[0], "r");
+	if (output == NULL) {
+		close(from_child[0]);
+		return;
+	}
+
+	/* Saludo inicial de pinentry. */
+	if (!response(NULL, 0)) {
+		fclose(output);
+		output = NULL;
+		return;
+	}
+
+	const char *tty = isatty(STDIN_FILENO) ? ttyname(STDIN_FILENO) : NULL;
+	if (tty != NULL) {
+		command(std::string("OPTION ttyname=") + tty);
+	}
+}
+
+PinentrySession::~PinentrySession() {
+	if (output != NULL) {
+		command("BYE");
+		fclose(output);
+	}
+	if (input >= 0) {
+		close(input);
+	}
+	if (child > 0) {
+		waitpid(child, NULL, 0);
+	}
+}
+
+bool PinentrySession::valid() const {
+	return output != NULL;
+}
+
+static int pinentry_hex(char c) {
+	if (c >= '0' && c <= '9') {
+		return c - '0';
+	}
+	if (c >= 'A' && c <= 'F') {
+		return c - 'A' + 10;
+	}
+	if (c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	}
+
+	return -1;
+}
+
+/*
+ * Lee líneas hasta OK o ERR. Los datos de las líneas D, con escapes %XX, se
+ * copian en data terminados en cero; si no caben se descarta la respuesta.
+ * Sin líneas D, como al confirmar un campo vacío, data queda vacío.
+ */
+bool PinentrySession::response(char *data, std::size_t data_max) {
+	char line[FIRMADOR_PINENTRY_LINE];
+	std::size_t length = 0;
+	bool fits = true;
+
+	if (data != NULL && data_max > 0) {
+		data[0] = 0;
+	}
+
+	for (;;) {
+		if (fgets(line, sizeof(line), output) == NULL) {
+			return false;
+		}
+
+		bool ok = strncmp(line, "OK", 2) == 0;
+		bool error = strncmp(line, "ERR", 3) == 0;
+		bool inquire = strncmp(line, "INQUIRE", 7) == 0;
+		bool data_line = strncmp(line, "D ", 2) == 0;
+		if (data_line && data != NULL) {
+			for (const char *c = line + 2; *c != 0 && *c != '\n';
+				c++) {
+				char value = *c;
+				if (*c == '%' && pinentry_hex(c[1]) >= 0
+					&& pinentry_hex(c[2]) >= 0) {
+					value = pinentry_hex(c[1]) << 4
+						| pinentry_hex(c[2]);
+					c += 2;
+				}
+				if (length + 1 < data_max) {
+					data[length++] = value;
+				} else {
+					fits = false;
+				}
+			}
+			data[length] = 0;
+		}
+		gnutls_memset(line, 0, sizeof(line));
+
+		if (ok) {
+			if (!fits) {
+				gnutls_memset(data, 0, data_max);
+			}
+			return fits;
+		}
+		if (error) {
+			return false;
+		}
+		if (inquire) {
+			if (write(input, "END\n", 4) != 4) {
+				return false;
+			}
+		}
+	}
+}
+
+bool PinentrySession::command(const std::string &line, char *data,
+	std::size_t data_max) {
+
+	std::string request = line + "\n";
+	if (write(input, request.c_str(), request.length())
+		!= (ssize_t) request.length()) {
+		return false;
+	}
+
+	return response(data, data_max);
+}
+
+/* Los textos no pueden llevar saltos de línea ni % sin escapar. */
+static std::string pinentry_escape(const std::string &text) {
+	std::string escaped;
+
+	for (std::size_t i = 0; i < text.length(); i++) {
+		switch (text[i]) {
+		case '%':
+			escaped += "%25";
+			break;
+		case '\n':
+			escaped += "%0A";
+			break;
+		case '\r':
+			escaped += "%0D";
+			break;
+		default:
+			escaped += text[i];
+		}
+	}
+
+	return escaped;
+}
+
+PinentryPrompt::PinentryPrompt(const std::string &program) :
+	program(program) {
+}
+
+int PinentryPrompt::pin(const std::string &description, char *pin,
+	std::size_t pin_max) {
+
+	std::lock_guard<std::mutex> lock(mutex);
+	PinentrySession session(program);
+
+	if (!session.valid()
+		|| !session.command("SETTITLE Introducción del PIN")
+		|| !session.command("SETDESC " + pinentry_escape(description))
+		|| !session.command("SETPROMPT PIN:")
+		|| !session.command("GETPIN", pin, pin_max)) {
+		return -1;
+	}
+
+	return pin[0] != 0 ? 0 : -1;
+}
+
+int PinentryPrompt::select(const std::vector<certificate_t> &certificates) {
+	std::lock_guard<std::mutex> lock(mutex);
+	PinentrySession session(program);
+
+	if (!session.valid()
+		|| !session.command("SETTITLE Selección de certificado")
+		|| !session.command("SETOK Firmar")) {
+		return -1;
+	}
+
+	for (std::size_t i = 0; i < certificates.size(); i++) {
+		bool last = i + 1 == certificates.size();
+		if (!session.command("SETDESC " + pinentry_escape(
+			"¿Firmar con el certificado de "
+			+ certificates.at(i).caption + "?"))
+			|| !session.command(last ? "SETCANCEL Cancelar"
+				: "SETCANCEL Siguiente")) {
+			return -1;
+		}
+		if (session.command("CONFIRM")) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+#endif
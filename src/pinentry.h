@@ -0,0 +1,50 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef FIRMADOR_PINENTRY_H
+#define FIRMADOR_PINENTRY_H
+
+#ifndef _WIN32
+
+#include "prompt.h"
+
+#include <mutex>
+#include <string>
+
+/*
+ * Pide el PIN con el programa pinentry de GnuPG, que tiene variantes para
+ * terminal y para cada escritorio. El certificado se elige confirmando uno
+ * a uno, porque pinentry no muestra listas.
+ */
+class PinentryPrompt : public Prompt {
+public:
+	explicit PinentryPrompt(const std::string &program);
+
+	virtual int pin(const std::string &description, char *pin,
+		std::size_t pin_max);
+	virtual int select(const std::vector<certificate_t> &certificates);
+
+private:
+	std::string program;
+	std::mutex mutex;
+};
+
+#endif
+
+#endif
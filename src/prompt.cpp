@@ -0,0 +1,194 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "prompt.h"
+#include "config.h"
+#include "pinentry.h"
+#ifdef FIRMADOR_GUI
+# include "gui.h"
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+
+#ifndef _WIN32
+# include <termios.h>
+# include <unistd.h>
+#endif
+
+#include <gnutls/gnutls.h>
+
+/*
+ * Lee una línea sin el salto final. Si no cabe en line se descarta entera,
+ * para no usar un PIN truncado.
+ */
+static bool prompt_line(FILE *file, char *line, std::size_t size) {
+	std::size_t length = 0;
+	bool fits = true;
+	int c;
+
+	while ((c = getc(file)) != EOF && c != '\n') {
+		if (length + 1 < size) {
+			line[length++] = c;
+		} else {
+			fits = false;
+		}
+	}
+	if (length > 0 && line[length - 1] == '\r') {
+		length--;
+	}
+	line[length] = 0;
+
+	if (!fits) {
+		gnutls_memset(line, 0, size);
+		return false;
+	}
+
+	return c != EOF || length > 0;
+}
+
+/*
+ * PIN de FIRMADOR_PIN_FILE o de la entrada estándar, sin eco si es una
+ * terminal, y certificado por número. Sirve para pruebas y servicios sin
+ * escritorio. Con un único certificado no se pregunta.
+ */
+class ConsolePrompt : public Prompt {
+public:
+	virtual int pin(const std::string &description, char *pin,
+		std::size_t pin_max);
+	virtual int select(const std::vector<certificate_t> &certificates);
+
+private:
+	std::mutex mutex;
+};
+
+int ConsolePrompt::pin(const std::string &description, char *pin,
+	std::size_t pin_max) {
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	const std::string &path = config().pin_file;
+	if (!path.empty()) {
+		FILE *file = fopen(path.c_str(), "r");
+		if (file == NULL) {
+			return -1;
+		}
+		bool read = prompt_line(file, pin, pin_max);
+		fclose(file);
+		return read && pin[0] != 0 ? 0 : -1;
+	}
+
+	fprintf(stderr, "%s ", description.c_str());
+	fflush(stderr);
+
+#ifndef _WIN32
+	struct termios saved;
+	bool terminal = isatty(STDIN_FILENO)
+		&& tcgetattr(STDIN_FILENO, &saved) == 0;
+	if (terminal) {
+		struct termios silent = saved;
+		silent.c_lflag &= ~ECHO;
+		tcsetattr(STDIN_FILENO, TCSAFLUSH, &silent);
+	}
+#endif
+
+	bool read = prompt_line(stdin, pin, pin_max);
+
+#ifndef _WIN32
+	if (terminal) {
+		tcsetattr(STDIN_FILENO, TCSAFLUSH, &saved);
+		fputc('\n', stderr);
+	}
+#endif
+
+	return read && pin[0] != 0 ? 0 : -1;
+}
+
+int ConsolePrompt::select(const std::vector<certificate_t> &certificates) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (certificates.size() <= 1) {
+		return certificates.empty() ? -1 : 0;
+	}
+
+	for (std::size_t i = 0; i < certificates.size(); i++) {
+		fprintf(stderr, "%lu) %s\n", (unsigned long) i + 1,
+			certificates.at(i).caption.c_str());
+	}
+	fprintf(stderr, "Certificado con el que se desea firmar: ");
+	fflush(stderr);
+
+	char line[16];
+	if (!prompt_line(stdin, line, sizeof(line))) {
+		return -1;
+	}
+
+	char *end;
+	unsigned long number = strtoul(line, &end, 10);
+	if (*end != 0 || number == 0 || number > certificates.size()) {
+		return -1;
+	}
+
+	return number - 1;
+}
+
+/*
+ * Sin nombre se usan los diálogos si hay interfaz gráfica y, si no, pinentry
+ * o, en Windows, la consola.
+ */
+Prompt *prompt_create(const std::string &name) {
+	std::string kind = name;
+
+	if (kind.empty()) {
+#if defined(FIRMADOR_GUI)
+		kind = config().headless ? "pinentry" : "gui";
+#elif defined(_WIN32)
+		kind = "console";
+#else
+		kind = "pinentry";
+#endif
+	}
+
+#ifdef FIRMADOR_GUI
+	if (kind == "gui" && !config().headless) {
+		return new GuiPrompt();
+	}
+#endif
+#ifndef _WIN32
+	if (kind == "pinentry") {
+		return new PinentryPrompt(config().pinentry);
+	}
+#endif
+	if (kind == "console") {
+		return new ConsolePrompt();
+	}
+
+	return NULL;
+}
+
+static Prompt *prompt_current = NULL;
+
+void prompt_set(Prompt *prompt) {
+	prompt_current = prompt;
+}
+
+Prompt &prompt() {
+	return *prompt_current;
+}
@@ -0,0 +1,49 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef FIRMADOR_PROMPT_H
+#define FIRMADOR_PROMPT_H
+
+#include "certificate.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/*
+ * Forma de pedir al usuario el PIN y el certificado: diálogos de wxWidgets en
+ * el escritorio o, sin interfaz gráfica, pinentry o la consola. Se llama
+ * desde los hilos de trabajo.
+ */
+class Prompt {
+public:
+	virtual ~Prompt() {}
+
+	/* Escribe en pin el PIN terminado en cero; 0 o -1 si no se obtiene. */
+	virtual int pin(const std::string &description, char *pin,
+		std::size_t pin_max) = 0;
+	/* Índice del certificado elegido o -1. */
+	virtual int select(const std::vector<certificate_t> &certificates) = 0;
+};
+
+Prompt *prompt_create(const std::string &name);
+void prompt_set(Prompt *prompt);
+Prompt &prompt();
+
+#endif
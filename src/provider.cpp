@@ -0,0 +1,143 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "provider.h"
+#include "config.h"
+#include "metrics.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <gnutls/pkcs11.h>
+
+/*
+ * Módulos PKCS#11 de la configuración. No se cargan al arrancar sino cuando
+ * una petición necesita por primera vez los certificados, así que arrancar
+ * por activación de socket o para atender /nexu-info no paga la
+ * inicialización de las bibliotecas de los fabricantes. Solo los carga el
+ * hilo de monitor_run, una única vez.
+ */
+static std::atomic<bool> provider_ready(false);
+
+/*
+ * Hilos que usan los módulos fuera de las peticiones, como los lectores de
+ * la caché que siguen vivos tras exceder el tiempo. provider_unload los
+ * espera antes de descargar los módulos.
+ */
+static unsigned int provider_holds = 0;
+static std::mutex provider_mutex;
+static std::condition_variable provider_condition;
+
+static MetricHistogram provider_add_seconds(FIRMADOR_METRICS_PKCS11,
+	"call=\"add_provider\"", FIRMADOR_METRICS_PKCS11_HELP);
+static MetricCounter provider_failures("firmador_provider_failures_total", "",
+	"Módulos PKCS#11 que no se han podido cargar.");
+
+/*
+ * Con FIRMADOR_PROVIDER_DISCOVERY entre los módulos, GnuTLS carga además los
+ * registrados en p11-kit. Un módulo que falla no impide usar los demás.
+ */
+int provider_load() {
+	if (provider_ready.load()) {
+		return GNUTLS_E_SUCCESS;
+	}
+
+	const std::vector<std::string> &modules = config().providers;
+	unsigned int flags = GNUTLS_PKCS11_FLAG_MANUAL;
+	for (std::size_t i = 0; i < modules.size(); i++) {
+		if (modules.at(i) == FIRMADOR_PROVIDER_DISCOVERY) {
+			flags = GNUTLS_PKCS11_FLAG_AUTO;
+		}
+	}
+
+	int ret;
+	{
+		MetricTimer timer(provider_add_seconds);
+		ret = gnutls_pkcs11_init(flags, NULL);
+	}
+	if (ret < GNUTLS_E_SUCCESS) {
+		provider_failures.add();
+		return ret;
+	}
+
+	int loaded = flags == GNUTLS_PKCS11_FLAG_AUTO ? 1 : 0;
+	for (std::size_t i = 0; i < modules.size(); i++) {
+		if (modules.at(i) == FIRMADOR_PROVIDER_DISCOVERY) {
+			continue;
+		}
+
+		{
+			MetricTimer timer(provider_add_seconds);
+			ret = gnutls_pkcs11_add_provider(
+				modules.at(i).c_str(), NULL);
+		}
+		if (ret < GNUTLS_E_SUCCESS) {
+			provider_failures.add();
+		} else {
+			loaded++;
+		}
+	}
+
+	provider_ready = true;
+
+	return loaded > 0 ? GNUTLS_E_SUCCESS : GNUTLS_E_PKCS11_LOAD_ERROR;
+}
+
+bool provider_loaded() {
+	return provider_ready.load();
+}
+
+/* Impide descargar los módulos hasta provider_release, si están cargados. */
+bool provider_hold() {
+	std::lock_guard<std::mutex> lock(provider_mutex);
+	if (!provider_ready.load()) {
+		return false;
+	}
+	provider_holds++;
+
+	return true;
+}
+
+void provider_release() {
+	std::lock_guard<std::mutex> lock(provider_mutex);
+	provider_holds--;
+	provider_condition.notify_all();
+}
+
+/*
+ * Un hilo que sigue dentro de un módulo pasado FIRMADOR_SLOT_TIMEOUT está
+ * colgado en el lector; antes que descargar el módulo bajo él, se deja
+ * cargado hasta que termine el proceso.
+ */
+void provider_unload() {
+	std::unique_lock<std::mutex> lock(provider_mutex);
+	if (!provider_ready.exchange(false)) {
+		return;
+	}
+
+	if (provider_condition.wait_for(lock,
+		std::chrono::seconds(config().slot_timeout),
+		[]() { return provider_holds == 0; })) {
+		gnutls_pkcs11_deinit();
+	}
+}
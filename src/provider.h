@@ -0,0 +1,32 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef FIRMADOR_PROVIDER_H
+#define FIRMADOR_PROVIDER_H
+
+/* Entrada de FIRMADOR_PROVIDER que carga los módulos registrados en p11-kit. */
+#define FIRMADOR_PROVIDER_DISCOVERY "p11-kit"
+
+int provider_load();
+bool provider_loaded();
+bool provider_hold();
+void provider_release();
+void provider_unload();
+
+#endif
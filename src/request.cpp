@@ -18,105 +18,955 @@ You should have received a copy of the GNU General Public License
 along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
 
 #include "request.h"
+#include "arena.h"
+#include "body.h"
+#include "cache.h"
+#include "config.h"
+#include "chain.h"
+#include "handle.h"
+#include "metrics.h"
+#include "prompt.h"
+#include "sign.h"
+#include "tls.h"
+#include "token.h"
+#include "uuid.h"
+#include "worker.h"
 
 #define FIRMADOR_STRING(s) #s
 #define FIRMADOR_EXPAND_STRING(e) FIRMADOR_STRING(e)
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
 #include <cstring>
-#include <iostream>
+#include <new>
+#include <sstream>
 #include <string>
+#include <vector>
 
-//TODO: usar TLS con el certificado generado por el instalador
-int request_callback(void *cls, struct MHD_Connection *connection,
-	const char *url, const char *method, const char *version,
-	const char *upload_data, std::size_t *upload_data_size,
-	void **con_cls) {
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
 
-	struct MHD_Response *response;
-	int ret;
-	int ret_code = MHD_HTTP_INTERNAL_SERVER_ERROR;
-	std::string page = "";
-	std::string content_type = "";
+/* La respuesta JSON y la pila del escritor van en la arena de la petición. */
+typedef rapidjson::GenericStringBuffer<rapidjson::UTF8<>, arena_allocator_t>
+	page_t;
+typedef rapidjson::Writer<page_t, rapidjson::UTF8<>, rapidjson::UTF8<>,
+	arena_allocator_t> writer_t;
 
-	(void)cls;
-	(void)version;
-	(void)upload_data;
-	(void)upload_data_size;
-	(void)con_cls;
-
-	if (strcmp(url, "/") == 0 || strcmp(url, "/nexu-info") == 0) {
-		ret_code = MHD_HTTP_OK;
-		page = "{ \"version\": \"1.10.5\"}";
-	}
-
-	if (strcmp(url, "/nexu.js") == 0) {
-		ret_code = MHD_HTTP_OK;
-		content_type = "text/javascript;charset=utf-8";
-		page = std::string() +
-			"function nexu_get_certificates(success, error)"
-			"{"
-			"req = new XMLHttpRequest();"
-			"req.open('POST', '//localhost:"
-			FIRMADOR_EXPAND_STRING(FIRMADOR_PORT)
-			"/rest/certificates');"
-			"req.setRequestHeader('Content-Type', 'application/json');"
-			"req.send();"
-			"}"
-			"function nexu_sign_with_token_infos(success, error)"
-			"{"
-			""
-			"}";
-	}
-
-	if (strcmp(url, "/rest/certificates") == 0) {
-		if (strcmp(method, MHD_HTTP_METHOD_OPTIONS) == 0) {
-			ret_code = MHD_HTTP_OK;
-		}
+struct route_t;
 
-		if (strcmp(method, MHD_HTTP_METHOD_POST) == 0) {
-			ret_code = MHD_HTTP_OK;
-			content_type = "application/json;charset=utf-8";
-			std::cout << "FIXME: abrir interfaz de certificados"
-				<< std::endl;
-			std::cout << "FIXME: enviar UUID, ID de certificado, "
-				<< "DER del certificado y DER de la cadena."
-				<< std::endl;
-		}
+/* Estado de cada petición, guardado en con_cls. */
+struct connection_t {
+	std::atomic<bool> done;
+	unsigned int status;
+	Arena arena;
+	page_t page;
+	const char *content_type;
+	bool close;
+	/* Rutas con la URL pedida y, entre ellas, la del método pedido. */
+	const route_t *first;
+	const route_t *last;
+	const route_t *route;
+	/* Bytes del cuerpo recibidos hasta ahora. */
+	std::size_t received;
+	bool too_large;
+	bool invalid;
+	sign_request_t request;
+	SignRequestParser parser;
+	SignDigest digest;
+	/* Para las métricas: cuándo empezó y qué código se respondió. */
+	std::chrono::steady_clock::time_point started;
+	unsigned int code;
+	bool options;
+
+	connection_t() : done(false), status(MHD_HTTP_OK),
+		page(&arena.allocator()),
+		content_type("application/json;charset=utf-8"),
+		close(true), first(NULL), last(NULL), route(NULL),
+		received(0), too_large(false), invalid(false),
+		parser(request), started(std::chrono::steady_clock::now()),
+		code(0), options(false) {}
+};
+
+typedef void (*handler_t)(connection_t *state);
+
+static void write_certificate(writer_t &writer,
+	const certificate_t &certificate) {
+
+	const std::string &key_id = certificate_key_id(certificate);
+	const std::string &der = certificate_der(certificate);
+
+	writer.Key("keyId");
+	writer.String(key_id.c_str(), key_id.length());
+	writer.Key("certificate");
+	writer.String(der.c_str(), der.length());
+	writer.Key("certificateChain");
+	writer.StartArray();
+	writer.String(der.c_str(), der.length());
+	const std::string &chain = chain_fragment(
+		certificate_authority(certificate));
+	if (!chain.empty()) {
+		writer.RawValue(chain.c_str(), chain.length(),
+			rapidjson::kStringType);
+	}
+	writer.EndArray();
+	writer.Key("encryptionAlgorithm");
+	writer.String(certificate.encryptionAlgorithm.c_str());
+}
+
+static void error_response(connection_t *state, const std::string &message) {
+	state->page.Clear();
+	writer_t writer(state->page, &state->arena.allocator());
+
+	writer.StartObject();
+	writer.Key("success");
+	writer.Bool(false);
+	writer.Key("feedback");
+	writer.Bool(false);
+	writer.Key("errorMessage");
+	writer.String(message.c_str());
+	writer.EndObject();
+}
+
+static void certificates_handler(connection_t *state) {
+	std::vector<certificate_t> certificates;
+
+	cache_certificates(certificates);
+
+	int selection = prompt().select(certificates);
+	if (selection < 0) {
+		error_response(state, "No se ha seleccionado ningún "
+			"certificado.");
+		return;
 	}
 
-	if (strcmp(url, "/rest/sign") == 0) {
-		if (strcmp(method, MHD_HTTP_METHOD_OPTIONS) == 0) {
-			ret_code = MHD_HTTP_OK;
-		}
+	certificate_t &certificate = certificates.at(selection);
+	certificate.id = uuid();
+	if (certificate.id.empty()) {
+		error_response(state, "No se ha podido generar el "
+			"identificador del dispositivo.");
+		return;
+	}
+	handle_register(certificate.id, certificate);
+
+	writer_t writer(state->page, &state->arena.allocator());
+
+	writer.StartObject();
+	writer.Key("success");
+	writer.Bool(true);
+	writer.Key("response");
+	writer.StartObject();
+	writer.Key("tokenId");
+	writer.StartObject();
+	writer.Key("id");
+	writer.String(certificate.id.c_str());
+	writer.EndObject();
+	write_certificate(writer, certificate);
+	writer.EndObject();
+	writer.EndObject();
+}
+
+/*
+ * Lee algoritmo de resumen y keyId comunes a las peticiones de firma y busca
+ * el certificado. Con el tokenId emitido en /rest/certificates se encuentra
+ * directamente; si no se envió o ya no es válido, se busca el keyId en los
+ * dispositivos conectados.
+ */
+static bool sign_prepare(connection_t *state, handle_t &handle,
+	gnutls_digest_algorithm_t &digest) {
+
+	const sign_request_t &request = state->request;
+
+	digest = sign_digest_algorithm(request.digest_algorithm);
+	if (digest == GNUTLS_DIG_UNKNOWN) {
+		state->status = MHD_HTTP_BAD_REQUEST;
+		error_response(state, "Algoritmo de resumen no soportado.");
+		return false;
+	}
 
-		if (strcmp(method, MHD_HTTP_METHOD_POST) == 0) {
-			ret_code = MHD_HTTP_OK;
-			content_type = "application/json;charset=utf-8";
-			std::cout << "FIXME: abrir interfaz de solicitar PIN "
-				<< "del token y firmar el PKCS#7 "
-				<< "proporcionado con el algoritmo indicado."
-				<< std::endl;
-			std::cout << "FIXME: enviar firma y algoritmo usado, "
-				<< "DER del certificado y DER de la cadena."
-				<< std::endl;
+	if (!request.token_id.empty()
+		&& handle_find(request.token_id, request.key_id, handle)) {
+		return true;
+	}
+
+	std::vector<certificate_t> certificates;
+	cache_certificates(certificates);
+
+	for (std::size_t i = 0; i < certificates.size(); i++) {
+		if (certificate_key_id(certificates.at(i)) == request.key_id) {
+			handle.certificate = certificates.at(i);
+			handle.key_url = token_key_url(handle.certificate.url);
+			return true;
 		}
 	}
 
-	response = MHD_create_response_from_buffer(page.length(),
-		(void*)page.c_str(), MHD_RESPMEM_MUST_COPY);
-	if (strcmp(page.c_str(), "") != 0) {
+	error_response(state, "No se ha encontrado el certificado "
+		"solicitado en los dispositivos conectados.");
+
+	return false;
+}
+
+static void sign_handler(connection_t *state) {
+	const sign_request_t &request = state->request;
+
+	if (request.batch || request.key_id.empty()
+		|| request.to_be_signed.size() != 1) {
+		state->status = MHD_HTTP_BAD_REQUEST;
+		error_response(state, "Petición de firma no válida.");
+		return;
+	}
+
+	handle_t handle;
+	gnutls_digest_algorithm_t digest;
+	if (!sign_prepare(state, handle, digest)) {
+		return;
+	}
+
+	std::string signature;
+	std::string algorithm;
+	int ret = request.hashed
+		? sign_hash(handle.key_url, digest,
+			request.to_be_signed.front(), signature, algorithm)
+		: sign_data(handle.key_url, digest,
+			request.to_be_signed.front(), signature, algorithm);
+	if (ret < GNUTLS_E_SUCCESS) {
+		error_response(state, std::string("Error al firmar: ")
+			+ gnutls_strerror(ret));
+		return;
+	}
+
+	writer_t writer(state->page, &state->arena.allocator());
+
+	writer.StartObject();
+	writer.Key("success");
+	writer.Bool(true);
+	writer.Key("response");
+	writer.StartObject();
+	writer.Key("signatureValue");
+	writer.String(signature.c_str());
+	writer.Key("signatureAlgorithm");
+	writer.String(algorithm.c_str());
+	write_certificate(writer, handle.certificate);
+	writer.EndObject();
+	writer.EndObject();
+}
+
+/*
+ * Igual que /rest/sign pero con un arreglo en toBeSigned. Todas las firmas se
+ * hacen con la misma clave abierta una vez y se devuelven en el mismo orden.
+ */
+static void sign_batch_handler(connection_t *state) {
+	const sign_request_t &request = state->request;
+
+	if (!request.batch || request.key_id.empty()
+		|| request.to_be_signed.empty()) {
+		state->status = MHD_HTTP_BAD_REQUEST;
+		error_response(state, "Petición de firma no válida.");
+		return;
+	}
+
+	handle_t handle;
+	gnutls_digest_algorithm_t digest;
+	if (!sign_prepare(state, handle, digest)) {
+		return;
+	}
+
+	std::vector<std::string> signatures;
+	std::string algorithm;
+	int ret = sign_data_batch(handle.key_url, digest,
+		request.to_be_signed, signatures, algorithm);
+	if (ret < GNUTLS_E_SUCCESS) {
+		error_response(state, std::string("Error al firmar: ")
+			+ gnutls_strerror(ret));
+		return;
+	}
+
+	writer_t writer(state->page, &state->arena.allocator());
+
+	writer.StartObject();
+	writer.Key("success");
+	writer.Bool(true);
+	writer.Key("response");
+	writer.StartObject();
+	writer.Key("signatureValues");
+	writer.StartArray();
+	for (std::size_t i = 0; i < signatures.size(); i++) {
+		writer.String(signatures.at(i).c_str());
+	}
+	writer.EndArray();
+	writer.Key("signatureAlgorithm");
+	writer.String(algorithm.c_str());
+	write_certificate(writer, handle.certificate);
+	writer.EndObject();
+	writer.EndObject();
+}
+
+/*
+ * Suspende la conexión y pasa el trabajo con la tarjeta a los hilos de
+ * trabajo. Al terminar se reanuda la conexión y libmicrohttpd vuelve a
+ * llamar a request_callback, que encola la respuesta ya preparada.
+ */
+static int request_async(struct MHD_Connection *connection,
+	connection_t *state, WorkerPool *workers, handler_t handler) {
+
+	MHD_suspend_connection(connection);
+	workers->submit([connection, state, handler]() {
+		handler(state);
+		state->done = true;
+		MHD_resume_connection(connection);
+	});
+
+	return MHD_YES;
+}
+
+static const char info_page[] = "{ \"version\": \"1.10.5\"}";
+
+static const char script_page[] =
+	"function nexu_get_certificates(success, error)"
+	"{"
+	"req = new XMLHttpRequest();"
+	"req.open('POST', '//localhost:"
+	FIRMADOR_EXPAND_STRING(FIRMADOR_PORT)
+	"/rest/certificates');"
+	"req.setRequestHeader('Content-Type', 'application/json');"
+	"req.send();"
+	"}"
+	"function nexu_sign_with_token_infos(success, error)"
+	"{"
+	""
+	"}";
+
+/*
+ * Estado de cada conexión TCP, que puede atender varias peticiones. Con TLS
+ * se guarda cuándo se aceptó para medir la negociación. spare es la memoria
+ * del connection_t de la petición anterior, ya destruido, para construir ahí
+ * el de la siguiente sin pedir memoria. Son algo más de FIRMADOR_ARENA_SIZE
+ * bytes que cada conexión persistente retiene mientras sigue abierta.
+ */
+struct socket_t {
+	unsigned long requests;
+	std::int64_t accepted;
+	bool negotiated;
+	void *spare;
+};
+
+static socket_t *request_socket(struct MHD_Connection *connection) {
+	const union MHD_ConnectionInfo *info = MHD_get_connection_info(
+		connection, MHD_CONNECTION_INFO_SOCKET_CONTEXT);
+	if (info == NULL) {
+		return NULL;
+	}
+
+	return static_cast<socket_t *>(info->socket_context);
+}
+
+/*
+ * Conexiones abiertas y microsegundos de reloj monótono en que se cerró la
+ * última, para saber cuánto lleva el servicio sin uso.
+ */
+static std::atomic<unsigned int> request_connections(0);
+static std::atomic<std::int64_t> request_activity(0);
+
+static std::int64_t request_now() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*
+ * Respuestas de contenido fijo, creadas una vez con sus cabeceras y
+ * reutilizadas en cada petición. Hay una variante que mantiene la conexión
+ * abierta y otra que la cierra, indexadas por connection_t::close.
+ */
+static struct MHD_Response *response_info[2];
+static struct MHD_Response *response_script[2];
+static struct MHD_Response *response_empty[2];
+
+static void response_headers(struct MHD_Response *response,
+	const char *content_type, bool close) {
+
+	if (content_type != NULL) {
 		MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_TYPE,
-			content_type.c_str());
+			content_type);
 	}
 	MHD_add_response_header(response, "Access-Control-Allow-Headers",
 		MHD_HTTP_HEADER_CONTENT_TYPE);
 	MHD_add_response_header(response, "Access-Control-Allow-Methods",
 		"OPTIONS, GET, POST");
 	MHD_add_response_header(response, "Access-Control-Allow-Origin", "*");
-	MHD_add_response_header(response, MHD_HTTP_HEADER_CONNECTION,
-		MHD_HTTP_HEADER_CLOSE);
-	ret = MHD_queue_response(connection, ret_code, response);
+	if (close) {
+		MHD_add_response_header(response, MHD_HTTP_HEADER_CONNECTION,
+			MHD_HTTP_HEADER_CLOSE);
+	}
+}
+
+static struct MHD_Response *response_static(const char *page,
+	std::size_t length, const char *content_type, bool close) {
+
+	struct MHD_Response *response = MHD_create_response_from_buffer(
+		length, (void*)page, MHD_RESPMEM_PERSISTENT);
+	response_headers(response, content_type, close);
+
+	return response;
+}
+
+static void latency_init();
+
+void request_init() {
+	request_activity = request_now();
+	latency_init();
+
+	for (int close = 0; close < 2; close++) {
+		response_info[close] = response_static(info_page,
+			sizeof(info_page) - 1,
+			"application/json;charset=utf-8", close);
+		response_script[close] = response_static(script_page,
+			sizeof(script_page) - 1,
+			"text/javascript;charset=utf-8", close);
+		response_empty[close] = response_static("", 0, NULL, close);
+	}
+}
+
+/*
+ * Si no hay conexiones abiertas ni las ha habido en los últimos segundos. Una
+ * firma en curso, incluso esperando el PIN, mantiene su conexión abierta.
+ */
+bool request_idle(unsigned long seconds) {
+	return request_connections == 0 && request_now() - request_activity
+		>= (std::int64_t) seconds * 1000000;
+}
+
+void request_deinit() {
+	for (int close = 0; close < 2; close++) {
+		MHD_destroy_response(response_info[close]);
+		MHD_destroy_response(response_script[close]);
+		MHD_destroy_response(response_empty[close]);
+	}
+}
+
+/*
+ * La primera petición de una conexión TLS llega en cuanto termina la
+ * negociación, así que el tiempo desde que se aceptó la mide, salvo lo que
+ * tarde en llegar la cabecera, despreciable en la interfaz local.
+ */
+static void request_handshake(struct MHD_Connection *connection) {
+	socket_t *socket = request_socket(connection);
+	if (socket == NULL || socket->negotiated) {
+		return;
+	}
+	socket->negotiated = true;
+
+	const union MHD_ConnectionInfo *info = MHD_get_connection_info(
+		connection,
+		MHD_CONNECTION_INFO_GNUTLS_SESSION);
+	if (info == NULL || info->tls_session == NULL) {
+		return;
+	}
+
+	tls_handshake(static_cast<gnutls_session_t>(info->tls_session),
+		request_now() - socket->accepted);
+}
+
+/*
+ * Decide si la conexión se cierra tras esta petición: siempre si está
+ * desactivado mantenerla y, si no, al llegar al máximo de peticiones.
+ */
+static bool request_close(struct MHD_Connection *connection) {
+	const config_t &options = config();
+
+	if (!options.keepalive) {
+		return true;
+	}
+
+	socket_t *socket = request_socket(connection);
+	if (socket == NULL) {
+		return false;
+	}
+
+	socket->requests++;
+
+	return options.connection_requests != 0
+		&& socket->requests >= options.connection_requests;
+}
+
+static int response_send(struct MHD_Connection *connection,
+	connection_t *state, unsigned int code,
+	struct MHD_Response *response) {
+
+	state->code = code;
+
+	return MHD_queue_response(connection, code, response);
+}
+
+/*
+ * El cuerpo es el búfer del estado de la petición, que vive hasta que
+ * libmicrohttpd avisa de que ha terminado, así que se entrega sin copiarlo.
+ */
+static int response_queue(struct MHD_Connection *connection,
+	connection_t *state) {
+
+	struct MHD_Response *response;
+	int ret;
+
+	response = MHD_create_response_from_buffer(state->page.GetSize(),
+		(void*)state->page.GetString(), MHD_RESPMEM_PERSISTENT);
+	response_headers(response, state->content_type, state->close);
+	ret = response_send(connection, state, state->status, response);
+	MHD_destroy_response(response);
+
+	return ret;
+}
+
+static int info_handler(struct MHD_Connection *connection,
+	connection_t *state) {
+
+	return response_send(connection, state, MHD_HTTP_OK,
+		response_info[state->close]);
+}
+
+static int script_handler(struct MHD_Connection *connection,
+	connection_t *state) {
+
+	return response_send(connection, state, MHD_HTTP_OK,
+		response_script[state->close]);
+}
+
+static int metrics_handler(struct MHD_Connection *connection,
+	connection_t *state) {
+
+	std::ostringstream metrics;
+	metrics_write(metrics);
+	std::string page = metrics.str();
+	memcpy(state->page.Push(page.length()), page.c_str(), page.length());
+	state->content_type = "text/plain; version=0.0.4";
+
+	return response_queue(connection, state);
+}
+
+/* Qué se hace con el cuerpo de la petición mientras llega. */
+enum route_body_t {
+	ROUTE_BODY_DISCARD,
+	/* Se decodifica como petición de firma en JSON. */
+	ROUTE_BODY_JSON,
+	/* Es el documento en bruto y solo se calcula su resumen. */
+	ROUTE_BODY_DIGEST
+};
+
+/*
+ * Tabla de rutas ordenada por ruta y método. Las rutas con respond se
+ * atienden en el hilo de libmicrohttpd; las que tienen work se ejecutan en los
+ * hilos de trabajo. OPTIONS se responde para cualquier ruta de la tabla.
+ */
+struct route_t {
+	const char *path;
+	const char *method;
+	int (*respond)(struct MHD_Connection *connection,
+		connection_t *state);
+	handler_t work;
+	route_body_t body;
+};
+
+static constexpr route_t routes[] = {
+	{"/", MHD_HTTP_METHOD_GET, &info_handler, NULL,
+		ROUTE_BODY_DISCARD},
+	{"/metrics", MHD_HTTP_METHOD_GET, &metrics_handler, NULL,
+		ROUTE_BODY_DISCARD},
+	{"/nexu-info", MHD_HTTP_METHOD_GET, &info_handler, NULL,
+		ROUTE_BODY_DISCARD},
+	{"/nexu.js", MHD_HTTP_METHOD_GET, &script_handler, NULL,
+		ROUTE_BODY_DISCARD},
+	{"/rest/certificates", MHD_HTTP_METHOD_POST, NULL,
+		&certificates_handler, ROUTE_BODY_DISCARD},
+	{"/rest/sign", MHD_HTTP_METHOD_POST, NULL, &sign_handler,
+		ROUTE_BODY_JSON},
+	{"/rest/sign/batch", MHD_HTTP_METHOD_POST, NULL,
+		&sign_batch_handler, ROUTE_BODY_JSON},
+	{"/rest/sign/stream", MHD_HTTP_METHOD_POST, NULL, &sign_handler,
+		ROUTE_BODY_DIGEST},
+};
+
+static constexpr std::size_t routes_size = sizeof(routes) / sizeof(routes[0]);
+
+static constexpr int route_compare(const char *a, const char *b) {
+	return *a != *b ? (unsigned char)*a - (unsigned char)*b
+		: *a == 0 ? 0 : route_compare(a + 1, b + 1);
+}
+
+static constexpr bool routes_sorted(std::size_t i) {
+	return i + 1 >= routes_size
+		|| ((route_compare(routes[i].path, routes[i + 1].path) < 0
+			|| (route_compare(routes[i].path, routes[i + 1].path)
+				== 0
+			&& route_compare(routes[i].method,
+				routes[i + 1].method) < 0))
+		&& routes_sorted(i + 1));
+}
+
+static_assert(routes_sorted(0), "rutas sin ordenar por ruta y método");
+
+/*
+ * Latencia por ruta, método y código. Hay una fila por ruta de la tabla, otra
+ * por la verificación CORS de cada ruta y una última para las URL que no
+ * están en la tabla; la última columna reúne los códigos no previstos.
+ */
+static const unsigned int latency_codes[] = {
+	MHD_HTTP_OK, MHD_HTTP_BAD_REQUEST, MHD_HTTP_NOT_FOUND,
+	MHD_HTTP_METHOD_NOT_ALLOWED, MHD_HTTP_PAYLOAD_TOO_LARGE
+};
+static constexpr std::size_t latency_codes_size =
+	sizeof(latency_codes) / sizeof(latency_codes[0]);
+
+static MetricHistogram *latency[routes_size * 2 + 1][latency_codes_size + 1];
+
+/*
+ * Se registran todas al arrancar; la mitad del registro queda para las demás
+ * métricas, así que una ruta o un código de más se detecta al compilar.
+ */
+static_assert((routes_size * 2 + 1) * (latency_codes_size + 1)
+	* FIRMADOR_METRICS_HISTOGRAM_SLOTS <= FIRMADOR_METRICS_SLOTS / 2,
+	"las series de latencia no caben en el registro de métricas");
+
+static void latency_init() {
+	if (latency[0][0] != NULL) {
+		return;
+	}
+
+	for (std::size_t row = 0; row <= routes_size * 2; row++) {
+		std::string labels = "route=\"other\",method=\"other\"";
+		if (row < routes_size * 2) {
+			const route_t &route = routes[row % routes_size];
+			const char *method = row < routes_size
+				? route.method : MHD_HTTP_METHOD_OPTIONS;
+			labels = std::string("route=\"") + route.path
+				+ "\",method=\"" + method + "\"";
+		}
+
+		for (std::size_t column = 0; column <= latency_codes_size;
+			column++) {
+			std::ostringstream code;
+			code << ",code=\"";
+			if (column < latency_codes_size) {
+				code << latency_codes[column];
+			} else {
+				code << "other";
+			}
+			code << "\"";
+
+			latency[row][column] = new MetricHistogram(
+				"firmador_request_seconds", labels + code.str(),
+				"Duración de las peticiones, desde las "
+				"cabeceras hasta enviar la respuesta.");
+		}
+	}
+}
+
+static void latency_record(const connection_t *state) {
+	std::size_t row = routes_size * 2;
+	if (state->route != NULL) {
+		row = state->route - routes;
+	} else if (state->options && state->first != state->last) {
+		row = routes_size + (state->first - routes);
+	}
+
+	std::size_t column = 0;
+	while (column < latency_codes_size
+		&& latency_codes[column] != state->code) {
+		column++;
+	}
+
+	latency[row][column]->observe(
+		std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - state->started).count());
+}
+
+struct route_path_less {
+	bool operator()(const route_t &route, const char *path) const {
+		return strcmp(route.path, path) < 0;
+	}
+	bool operator()(const char *path, const route_t &route) const {
+		return strcmp(path, route.path) < 0;
+	}
+};
+
+/*
+ * Las rutas estáticas responden también a HEAD; libmicrohttpd envía entonces
+ * las cabeceras de la respuesta de GET sin el cuerpo.
+ */
+static bool route_head(const route_t *route) {
+	return route->respond != NULL
+		&& strcmp(route->method, MHD_HTTP_METHOD_GET) == 0;
+}
+
+static int response_not_allowed(struct MHD_Connection *connection,
+	connection_t *state) {
+
+	std::string allow = MHD_HTTP_METHOD_OPTIONS;
+	for (const route_t *route = state->first; route != state->last;
+		route++) {
+		allow = allow + ", " + route->method;
+		if (route_head(route)) {
+			allow = allow + ", " + MHD_HTTP_METHOD_HEAD;
+		}
+	}
+
+	struct MHD_Response *response;
+	int ret;
+
+	response = MHD_create_response_from_buffer(0, (void*)"",
+		MHD_RESPMEM_PERSISTENT);
+	response_headers(response, NULL, state->close);
+	MHD_add_response_header(response, MHD_HTTP_HEADER_ALLOW,
+		allow.c_str());
+	ret = response_send(connection, state, MHD_HTTP_METHOD_NOT_ALLOWED,
+		response);
 	MHD_destroy_response(response);
 
 	return ret;
 }
+
+static std::string request_argument(struct MHD_Connection *connection,
+	const char *name) {
+
+	const char *value = MHD_lookup_connection_value(connection,
+		MHD_GET_ARGUMENT_KIND, name);
+
+	return value != NULL ? value : "";
+}
+
+/*
+ * /rest/sign/stream recibe el documento en bruto como cuerpo y keyId,
+ * tokenId y digestAlgorithm en la URL, así que el resumen se empieza a
+ * calcular antes de que llegue el primer trozo.
+ */
+static int request_stream(struct MHD_Connection *connection,
+	connection_t *state) {
+
+	sign_request_t &request = state->request;
+	request.hashed = true;
+	request.key_id = request_argument(connection, "keyId");
+	request.token_id = request_argument(connection, "tokenId");
+	request.digest_algorithm = request_argument(connection,
+		"digestAlgorithm");
+
+	gnutls_digest_algorithm_t algorithm = sign_digest_algorithm(
+		request.digest_algorithm);
+	if (algorithm == GNUTLS_DIG_UNKNOWN) {
+		state->status = MHD_HTTP_BAD_REQUEST;
+		state->close = true;
+		error_response(state, "Algoritmo de resumen no soportado.");
+		return response_queue(connection, state);
+	}
+
+	if (state->digest.init(algorithm) < GNUTLS_E_SUCCESS) {
+		state->invalid = true;
+	}
+
+	return MHD_YES;
+}
+
+/*
+ * Busca la ruta al llegar las cabeceras, antes que el cuerpo, para saber si
+ * hay que decodificarlo. Si Content-Length ya excede el máximo se responde
+ * 413 sin leer el cuerpo. El documento de /rest/sign/stream no se guarda y
+ * no tiene máximo.
+ */
+static int request_route(struct MHD_Connection *connection,
+	connection_t *state, const char *url, const char *method) {
+
+	std::pair<const route_t *, const route_t *> range = std::equal_range(
+		routes, routes + routes_size, url, route_path_less());
+
+	state->first = range.first;
+	state->last = range.second;
+	for (const route_t *route = range.first; route != range.second;
+		route++) {
+		if (strcmp(route->method, method) == 0
+			|| (strcmp(method, MHD_HTTP_METHOD_HEAD) == 0
+			&& route_head(route))) {
+			state->route = route;
+			break;
+		}
+	}
+
+	if (state->route != NULL && state->route->body == ROUTE_BODY_DIGEST) {
+		return request_stream(connection, state);
+	}
+
+	const char *length = MHD_lookup_connection_value(connection,
+		MHD_HEADER_KIND, MHD_HTTP_HEADER_CONTENT_LENGTH);
+	if (length != NULL
+		&& strtoull(length, NULL, 10) > config().body_max) {
+		return response_send(connection, state,
+			MHD_HTTP_PAYLOAD_TOO_LARGE, response_empty[true]);
+	}
+
+	return MHD_YES;
+}
+
+/*
+ * Cada trozo del cuerpo se pasa al decodificador y se descarta, de modo que
+ * nunca se guarda el cuerpo completo. El límite se comprueba también aquí
+ * porque el cuerpo puede venir por trozos sin Content-Length.
+ */
+static void request_body(connection_t *state, const char *data,
+	std::size_t size) {
+
+	if (state->route != NULL && state->route->body == ROUTE_BODY_DIGEST) {
+		if (!state->invalid && !state->digest.update(data, size)) {
+			state->invalid = true;
+		}
+		return;
+	}
+
+	state->received += size;
+	if (state->received > config().body_max) {
+		state->too_large = true;
+		return;
+	}
+
+	if (state->route == NULL || state->route->body != ROUTE_BODY_JSON
+		|| state->invalid) {
+		return;
+	}
+	if (!state->parser.feed(data, size)) {
+		state->invalid = true;
+	}
+}
+
+static connection_t *request_state(struct MHD_Connection *connection) {
+	socket_t *socket = request_socket(connection);
+	void *memory;
+	if (socket != NULL && socket->spare != NULL) {
+		memory = socket->spare;
+		socket->spare = NULL;
+	} else {
+		memory = ::operator new(sizeof(connection_t));
+	}
+
+	return new (memory) connection_t();
+}
+
+int request_callback(void *cls, struct MHD_Connection *connection,
+	const char *url, const char *method, const char *version,
+	const char *upload_data, std::size_t *upload_data_size,
+	void **con_cls) {
+
+	WorkerPool *workers = static_cast<WorkerPool *>(cls);
+	connection_t *state = static_cast<connection_t *>(*con_cls);
+
+	(void)version;
+
+	if (state == NULL) {
+		request_handshake(connection);
+		state = request_state(connection);
+		state->close = request_close(connection);
+		*con_cls = state;
+		return request_route(connection, state, url, method);
+	}
+
+	if (*upload_data_size != 0) {
+		request_body(state, upload_data, *upload_data_size);
+		*upload_data_size = 0;
+		return MHD_YES;
+	}
+
+	if (state->done) {
+		return response_queue(connection, state);
+	}
+
+	if (state->first == state->last) {
+		return response_send(connection, state, MHD_HTTP_NOT_FOUND,
+			response_empty[state->close]);
+	}
+
+	if (strcmp(method, MHD_HTTP_METHOD_OPTIONS) == 0) {
+		state->options = true;
+		return response_send(connection, state, MHD_HTTP_OK,
+			response_empty[state->close]);
+	}
+
+	const route_t *route = state->route;
+	if (route == NULL) {
+		return response_not_allowed(connection, state);
+	}
+
+	if (state->too_large) {
+		return response_send(connection, state,
+			MHD_HTTP_PAYLOAD_TOO_LARGE, response_empty[true]);
+	}
+
+	if ((route->body == ROUTE_BODY_JSON
+		&& (state->invalid || !state->parser.finish()))
+		|| (route->body == ROUTE_BODY_DIGEST && state->invalid)) {
+		state->status = MHD_HTTP_BAD_REQUEST;
+		error_response(state, state->request.overflow
+			? "Demasiados documentos en la petición."
+			: "Petición de firma no válida.");
+		return response_queue(connection, state);
+	}
+
+	if (route->body == ROUTE_BODY_DIGEST) {
+		state->request.to_be_signed.push_back(state->digest.finish());
+	}
+
+	if (route->work != NULL) {
+		return request_async(connection, state, workers, route->work);
+	}
+
+	return route->respond(connection, state);
+}
+
+void request_connection(void *cls, struct MHD_Connection *connection,
+	void **socket_context, enum MHD_ConnectionNotificationCode toe) {
+
+	(void)cls;
+
+	if (toe == MHD_CONNECTION_NOTIFY_STARTED) {
+		socket_t *socket = new socket_t();
+		socket->requests = 0;
+		socket->accepted = request_now();
+		socket->negotiated = false;
+		socket->spare = NULL;
+		*socket_context = socket;
+
+		const union MHD_ConnectionInfo *info = MHD_get_connection_info(
+			connection, MHD_CONNECTION_INFO_GNUTLS_SESSION);
+		if (info != NULL && info->tls_session != NULL) {
+			tls_session(static_cast<gnutls_session_t>(
+				info->tls_session));
+		}
+		request_connections++;
+	} else {
+		request_activity = request_now();
+		request_connections--;
+		socket_t *socket = static_cast<socket_t *>(*socket_context);
+		::operator delete(socket->spare);
+		delete socket;
+		*socket_context = NULL;
+	}
+}
+
+void request_completed(void *cls, struct MHD_Connection *connection,
+	void **con_cls, enum MHD_RequestTerminationCode toe) {
+
+	(void)cls;
+	(void)toe;
+
+	connection_t *state = static_cast<connection_t *>(*con_cls);
+	if (state == NULL) {
+		return;
+	}
+
+	latency_record(state);
+
+	/* La arena y todo lo demás se liberan aquí de una vez. */
+	socket_t *socket = request_socket(connection);
+	state->~connection_t();
+	if (socket != NULL && socket->spare == NULL) {
+		socket->spare = state;
+	} else {
+		::operator delete(state);
+	}
+	*con_cls = NULL;
+}
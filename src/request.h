@@ -26,9 +26,44 @@ along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
 
 #define FIRMADOR_PORT 9795
 
+/* Nombre anterior a libmicrohttpd 0.9.55. */
+#ifndef MHD_HTTP_PAYLOAD_TOO_LARGE
+# define MHD_HTTP_PAYLOAD_TOO_LARGE MHD_HTTP_REQUEST_ENTITY_TOO_LARGE
+#endif
+
+/*
+ * Un único hilo interno atiende todas las conexiones; las operaciones lentas
+ * suspenden la conexión mientras se ejecutan en los hilos de trabajo.
+ */
+#if MHD_VERSION >= 0x00095400
+# define FIRMADOR_MHD_FLAGS \
+	(MHD_USE_AUTO_INTERNAL_THREAD | MHD_ALLOW_SUSPEND_RESUME)
+#else
+# define FIRMADOR_MHD_FLAGS \
+	(MHD_USE_SELECT_INTERNALLY | MHD_USE_SUSPEND_RESUME)
+#endif
+
+/* Nombre anterior a libmicrohttpd 0.9.54. */
+#if MHD_VERSION >= 0x00095400
+# define FIRMADOR_MHD_TLS MHD_USE_TLS
+#else
+# define FIRMADOR_MHD_TLS MHD_USE_SSL
+#endif
+
+void request_init();
+void request_deinit();
+
+bool request_idle(unsigned long seconds);
+
 int request_callback(void *cls, struct MHD_Connection *connection,
 	const char *url, const char *method, const char *version,
 	const char *upload_data, std::size_t *upload_data_size,
 	void **con_cls);
 
+void request_connection(void *cls, struct MHD_Connection *connection,
+	void **socket_context, enum MHD_ConnectionNotificationCode toe);
+
+void request_completed(void *cls, struct MHD_Connection *connection,
+	void **con_cls, enum MHD_RequestTerminationCode toe);
+
 #endif
\ No newline at end of file
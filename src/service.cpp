@@ -0,0 +1,247 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "service.h"
+#include "activation.h"
+#include "cache.h"
+#include "chain.h"
+#include "config.h"
+#include "handle.h"
+#include "localhost.h"
+#include "monitor.h"
+#include "pin.h"
+#include "prompt.h"
+#include "provider.h"
+#include "request.h"
+#include "session.h"
+#include "tls.h"
+#include "worker.h"
+
+#include <csignal>
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+#ifndef _WIN32
+# include <arpa/inet.h>
+# include <unistd.h>
+#else
+# include <winsock2.h>
+#endif
+
+#include <gnutls/pkcs11.h>
+#include <microhttpd.h>
+
+static struct MHD_Daemon *service_daemon = NULL;
+static WorkerPool *service_workers = NULL;
+static int service_socket = -1;
+static Prompt *service_prompt = NULL;
+
+static bool service_error(std::string &title, std::string &message,
+	const char *error_title, const std::string &error_message, int ret) {
+
+	std::ostringstream error;
+	error << error_message;
+	if (ret < GNUTLS_E_SUCCESS) {
+		error << std::endl << gnutls_strerror(ret);
+	}
+
+	title = error_title;
+	message = error.str();
+
+	delete service_prompt;
+	service_prompt = NULL;
+	prompt_set(NULL);
+
+	return false;
+}
+
+/*
+ * Sin certificado configurado se usa el de localhost generado con la CA
+ * local, que se renueva solo mientras el servicio está en marcha.
+ */
+static int service_tls() {
+	int ret = tls_init();
+	if (ret < GNUTLS_E_SUCCESS) {
+		return ret;
+	}
+
+	if (!config().tls_certificate.empty()) {
+		return tls_files(config().tls_certificate, config().tls_key);
+	}
+
+	ret = localhost_load(config().tls_directory);
+	if (ret == GNUTLS_E_SUCCESS) {
+		localhost_start();
+	}
+
+	return ret;
+}
+
+bool service_start(std::string &title, std::string &message) {
+	int ret;
+
+	ret = chain_load(config().ca_directory);
+	if (ret < GNUTLS_E_SUCCESS) {
+		return service_error(title, message,
+			"Error al cargar la cadena",
+			"Cadena de certificados no válida:", ret);
+	}
+
+	service_prompt = prompt_create(config().prompt);
+	if (service_prompt == NULL) {
+		return service_error(title, message, "Error de configuración",
+			"Forma de solicitar el PIN no soportada: "
+			+ config().prompt, GNUTLS_E_SUCCESS);
+	}
+	prompt_set(service_prompt);
+
+#ifndef _WIN32
+	/* Que un pinentry que termina antes de tiempo no cierre el servicio. */
+	signal(SIGPIPE, SIG_IGN);
+#endif
+
+	/* Los módulos se cargan con la primera petición de certificados. */
+	if (config().providers.empty()) {
+		return service_error(title, message, "Sistema no soportado",
+			"Sistema no soportado por el firmador.\n"
+			"El fabricante de la tarjeta solamente soporta "
+			"GNU/Linux, macOS y Windows con procesadores x86 y "
+			"x86_64. Se puede indicar otro módulo PKCS#11 en "
+			"FIRMADOR_PROVIDER.", GNUTLS_E_SUCCESS);
+	}
+	gnutls_pkcs11_set_pin_function(pin_callback, NULL);
+
+	struct sockaddr_in daemon_ip_addr;
+	memset(&daemon_ip_addr, 0, sizeof(struct sockaddr_in));
+	daemon_ip_addr.sin_family = AF_INET;
+	daemon_ip_addr.sin_port = htons(FIRMADOR_PORT);
+	daemon_ip_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	/*
+	 * Activado por systemd o con service_listen el socket ya está a la
+	 * escucha y puede tener conexiones esperando; si no, se abre el puerto
+	 * local.
+	 */
+	std::vector<struct MHD_OptionItem> options;
+	int fd = service_socket >= 0 ? service_socket : activation_socket();
+	if (fd >= 0) {
+		struct MHD_OptionItem option = {
+			MHD_OPTION_LISTEN_SOCKET, fd, NULL };
+		options.push_back(option);
+	} else {
+		struct MHD_OptionItem option = {
+			MHD_OPTION_SOCK_ADDR, 0, &daemon_ip_addr };
+		options.push_back(option);
+	}
+
+	unsigned int flags = FIRMADOR_MHD_FLAGS;
+	if (config().tls) {
+		ret = service_tls();
+		if (ret < GNUTLS_E_SUCCESS) {
+			tls_deinit();
+			return service_error(title, message,
+				"Error al cargar el certificado",
+				config().tls_certificate.empty()
+				? "No se ha podido generar el certificado "
+				"HTTPS en " + config().tls_directory + ":"
+				: "No se ha podido cargar el certificado HTTPS "
+				+ config().tls_certificate + " o su clave "
+				+ config().tls_key + ":", ret);
+		}
+
+		flags |= FIRMADOR_MHD_TLS;
+		struct MHD_OptionItem tls_options[] = {
+			{ MHD_OPTION_HTTPS_CERT_CALLBACK, 0,
+				(void *) &tls_retrieve },
+			{ MHD_OPTION_HTTPS_PRIORITIES, 0,
+				(void *) FIRMADOR_TLS_PRIORITIES }
+		};
+		options.insert(options.end(), tls_options, tls_options + 2);
+	}
+
+	struct MHD_OptionItem end = { MHD_OPTION_END, 0, NULL };
+	options.push_back(end);
+
+	service_workers = new WorkerPool(FIRMADOR_WORKERS);
+	request_init();
+
+	service_daemon = MHD_start_daemon(flags,
+		FIRMADOR_PORT, NULL, NULL, &request_callback, service_workers,
+		MHD_OPTION_ARRAY, &options[0],
+		MHD_OPTION_CONNECTION_TIMEOUT,
+			(unsigned int) config().connection_timeout,
+		MHD_OPTION_NOTIFY_CONNECTION, &request_connection, NULL,
+		MHD_OPTION_NOTIFY_COMPLETED, &request_completed, NULL,
+		MHD_OPTION_END);
+	if (service_daemon == NULL) {
+		/* Sin servicio nadie más conoce el ejecutor. */
+		delete service_workers;
+		service_workers = NULL;
+		request_deinit();
+		localhost_stop();
+		tls_deinit();
+		return service_error(title, message, "Error al iniciar",
+			"No se ha podido iniciar el servicio firmador.\n"
+			"El puerto podría estar ocupado por otro servicio.",
+			GNUTLS_E_SUCCESS);
+	}
+
+	monitor_start();
+
+	return true;
+}
+
+void service_listen(int fd) {
+	service_socket = fd;
+}
+
+void service_stop() {
+	/*
+	 * Se dejan de aceptar conexiones y se vacía la cola de trabajo para que
+	 * toda conexión suspendida se reanude antes de detener el servicio. El
+	 * ejecutor sigue siendo el cls del servicio hasta que este se detiene.
+	 */
+	MHD_socket fd = MHD_quiesce_daemon(service_daemon);
+	service_workers->stop();
+	MHD_stop_daemon(service_daemon);
+	service_daemon = NULL;
+	if (fd != MHD_INVALID_SOCKET) {
+#ifdef _WIN32
+		closesocket(fd);
+#else
+		close(fd);
+#endif
+	}
+	delete service_workers;
+	service_workers = NULL;
+	request_deinit();
+	localhost_stop();
+	tls_deinit();
+
+	monitor_stop();
+	cache_clear();
+	handle_clear();
+	session_clear();
+	provider_unload();
+
+	prompt_set(NULL);
+	delete service_prompt;
+	service_prompt = NULL;
+}
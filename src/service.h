@@ -0,0 +1,39 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef FIRMADOR_SERVICE_H
+#define FIRMADOR_SERVICE_H
+
+#include <string>
+
+/*
+ * Núcleo del firmador, sin wxWidgets: proveedor PKCS#11, caché de
+ * certificados y servicio HTTP. Si no arranca deja en title y message la
+ * descripción del error para mostrarla al usuario.
+ */
+bool service_start(std::string &title, std::string &message);
+void service_stop();
+
+/*
+ * Socket ya a la escucha que service_start usa en lugar de la activación por
+ * systemd y del puerto local, como hace el banco de pruebas de HTTP.
+ */
+void service_listen(int fd);
+
+#endif
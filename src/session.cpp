@@ -0,0 +1,226 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "session.h"
+#include "config.h"
+#include "metrics.h"
+#include "token.h"
+
+#include <chrono>
+#include <map>
+#include <mutex>
+
+/*
+ * Claves privadas ya importadas y con sesión iniciada en el token. Mientras
+ * la clave sigue abierta el token no vuelve a pedir el PIN, así que las firmas
+ * seguidas se saltan el diálogo y el C_Login. Está desactivado salvo que se
+ * configure FIRMADOR_SESSION_TTL.
+ */
+struct session_t {
+	gnutls_privkey_t key;
+	std::chrono::steady_clock::time_point used;
+	unsigned long operations;
+	bool busy;
+	bool stale;
+};
+
+typedef std::map<std::string, session_t> sessions_t;
+
+static sessions_t sessions;
+static std::mutex sessions_mutex;
+
+static MetricHistogram session_import_seconds(FIRMADOR_METRICS_PKCS11,
+	"call=\"privkey_import_url\"", FIRMADOR_METRICS_PKCS11_HELP);
+
+static int session_import(const std::string &key_url, gnutls_privkey_t *key) {
+	int ret = gnutls_privkey_init(key);
+	if (ret < GNUTLS_E_SUCCESS) {
+		return ret;
+	}
+
+	{
+		MetricTimer timer(session_import_seconds);
+		ret = gnutls_privkey_import_url(*key, key_url.c_str(), 0);
+	}
+	if (ret < GNUTLS_E_SUCCESS) {
+		gnutls_privkey_deinit(*key);
+		return ret;
+	}
+
+	return GNUTLS_E_SUCCESS;
+}
+
+static bool session_expired(const session_t &session,
+	std::chrono::steady_clock::time_point now) {
+
+	const config_t &options = config();
+
+	return session.stale
+		|| now - session.used
+			>= std::chrono::seconds(options.session_ttl)
+		|| (options.session_operations != 0
+			&& session.operations >= options.session_operations);
+}
+
+int session_acquire(const std::string &key_url, gnutls_privkey_t *key) {
+	if (config().session_ttl != 0) {
+		std::lock_guard<std::mutex> lock(sessions_mutex);
+
+		sessions_t::iterator it = sessions.find(key_url);
+		if (it != sessions.end() && !it->second.busy) {
+			if (!session_expired(it->second,
+				std::chrono::steady_clock::now())) {
+				it->second.busy = true;
+				*key = it->second.key;
+				return GNUTLS_E_SUCCESS;
+			}
+			gnutls_privkey_deinit(it->second.key);
+			sessions.erase(it);
+		}
+	}
+
+	return session_import(key_url, key);
+}
+
+/*
+ * Devuelve la clave tras usarla. Si la caché está desactivada, la operación
+ * falló o la sesión ha agotado su límite, la clave se libera.
+ */
+void session_release(const std::string &key_url, gnutls_privkey_t key,
+	unsigned long operations, bool failed) {
+
+	const config_t &options = config();
+
+	if (options.session_ttl == 0 || options.session_max == 0) {
+		gnutls_privkey_deinit(key);
+		return;
+	}
+
+	std::chrono::steady_clock::time_point now =
+		std::chrono::steady_clock::now();
+	std::unique_lock<std::mutex> lock(sessions_mutex);
+
+	sessions_t::iterator it = sessions.find(key_url);
+	if (it != sessions.end() && it->second.key != key) {
+		/* Otra petición tenía la sesión; esta clave era temporal. */
+		lock.unlock();
+		gnutls_privkey_deinit(key);
+		return;
+	}
+
+	if (it == sessions.end()) {
+		if (failed) {
+			lock.unlock();
+			gnutls_privkey_deinit(key);
+			return;
+		}
+
+		/* Lleno: se cierra la sesión libre usada hace más tiempo. */
+		if (sessions.size() >= options.session_max) {
+			sessions_t::iterator oldest = sessions.end();
+			for (sessions_t::iterator candidate = sessions.begin();
+				candidate != sessions.end(); ++candidate) {
+				if (!candidate->second.busy
+					&& (oldest == sessions.end()
+					|| candidate->second.used
+					< oldest->second.used)) {
+					oldest = candidate;
+				}
+			}
+			if (oldest == sessions.end()) {
+				lock.unlock();
+				gnutls_privkey_deinit(key);
+				return;
+			}
+			gnutls_privkey_deinit(oldest->second.key);
+			sessions.erase(oldest);
+		}
+
+		session_t session;
+		session.key = key;
+		session.operations = 0;
+		session.stale = false;
+		it = sessions.insert(std::make_pair(key_url, session)).first;
+	}
+
+	it->second.busy = false;
+	it->second.used = now;
+	it->second.operations += operations;
+
+	if (failed || session_expired(it->second, now)) {
+		gnutls_privkey_deinit(it->second.key);
+		sessions.erase(it);
+	}
+}
+
+void session_expire() {
+	std::chrono::steady_clock::time_point now =
+		std::chrono::steady_clock::now();
+	std::lock_guard<std::mutex> lock(sessions_mutex);
+
+	for (sessions_t::iterator it = sessions.begin();
+		it != sessions.end(); ) {
+		if (!it->second.busy && session_expired(it->second, now)) {
+			gnutls_privkey_deinit(it->second.key);
+			sessions.erase(it++);
+		} else {
+			++it;
+		}
+	}
+}
+
+/* Descarta una sesión; si está en uso, al devolverla. */
+static void session_drop(sessions_t::iterator &it) {
+	if (it->second.busy) {
+		/* Quien la usa la liberará al devolverla. */
+		it->second.stale = true;
+		++it;
+	} else {
+		gnutls_privkey_deinit(it->second.key);
+		sessions.erase(it++);
+	}
+}
+
+/*
+ * Cierra las sesiones del token retirado. El número de serie va en el URL de
+ * la clave, así que no hace falta consultar el token, que ya no está; las
+ * claves de tokens sin número de serie se cierran también.
+ */
+void session_invalidate(const std::string &serial) {
+	std::lock_guard<std::mutex> lock(sessions_mutex);
+
+	for (sessions_t::iterator it = sessions.begin();
+		it != sessions.end(); ) {
+		std::string key_serial = token_serial(it->first);
+		if (key_serial == serial || key_serial == it->first) {
+			session_drop(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+void session_clear() {
+	std::lock_guard<std::mutex> lock(sessions_mutex);
+
+	for (sessions_t::iterator it = sessions.begin();
+		it != sessions.end(); ) {
+		session_drop(it);
+	}
+}
@@ -0,0 +1,34 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef FIRMADOR_SESSION_H
+#define FIRMADOR_SESSION_H
+
+#include <string>
+
+#include <gnutls/abstract.h>
+
+int session_acquire(const std::string &key_url, gnutls_privkey_t *key);
+void session_release(const std::string &key_url, gnutls_privkey_t key,
+	unsigned long operations, bool failed);
+void session_expire();
+void session_invalidate(const std::string &serial);
+void session_clear();
+
+#endif
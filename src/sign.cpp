@@ -0,0 +1,213 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "sign.h"
+#include "base64.h"
+#include "metrics.h"
+#include "session.h"
+
+#include <gnutls/abstract.h>
+
+/* Nombres de algoritmo de resumen usados por DSS y NexU. */
+gnutls_digest_algorithm_t sign_digest_algorithm(const std::string &name) {
+	if (name == "SHA256" || name.empty()) {
+		return GNUTLS_DIG_SHA256;
+	}
+	if (name == "SHA384") {
+		return GNUTLS_DIG_SHA384;
+	}
+	if (name == "SHA512") {
+		return GNUTLS_DIG_SHA512;
+	}
+	if (name == "SHA1") {
+		return GNUTLS_DIG_SHA1;
+	}
+
+	return GNUTLS_DIG_UNKNOWN;
+}
+
+/* Nombre del algoritmo de firma como lo espera DSS, por ejemplo RSA_SHA256. */
+static std::string sign_algorithm_name(int pk,
+	gnutls_digest_algorithm_t digest) {
+
+	std::string name;
+
+	switch (pk) {
+	case GNUTLS_PK_RSA:
+		name = "RSA";
+		break;
+	case GNUTLS_PK_EC:
+		name = "ECDSA";
+		break;
+	case GNUTLS_PK_DSA:
+		name = "DSA";
+		break;
+	default:
+		name = gnutls_pk_algorithm_get_name((gnutls_pk_algorithm_t) pk);
+	}
+
+	return name + "_" + gnutls_digest_get_name(digest);
+}
+
+static MetricHistogram sign_seconds(FIRMADOR_METRICS_PKCS11,
+	"call=\"sign_data\"", FIRMADOR_METRICS_PKCS11_HELP);
+static MetricHistogram sign_hash_seconds(FIRMADOR_METRICS_PKCS11,
+	"call=\"sign_hash\"", FIRMADOR_METRICS_PKCS11_HELP);
+
+SignDigest::~SignDigest() {
+	if (hash != NULL) {
+		gnutls_hash_deinit(hash, NULL);
+	}
+}
+
+int SignDigest::init(gnutls_digest_algorithm_t algorithm) {
+	this->algorithm = algorithm;
+
+	int ret = gnutls_hash_init(&hash, algorithm);
+	if (ret < GNUTLS_E_SUCCESS) {
+		hash = NULL;
+	}
+
+	return ret;
+}
+
+bool SignDigest::update(const char *data, std::size_t size) {
+	return hash != NULL
+		&& gnutls_hash(hash, data, size) == GNUTLS_E_SUCCESS;
+}
+
+std::string SignDigest::finish() {
+	if (hash == NULL) {
+		return std::string();
+	}
+
+	std::string digest(gnutls_hash_get_len(algorithm), 0);
+	gnutls_hash_deinit(hash, &digest[0]);
+	hash = NULL;
+
+	return digest;
+}
+
+/*
+ * Con hashed los datos son ya el resumen, así que a la tarjeta solo llegan
+ * sus 32 a 64 bytes.
+ */
+static int sign_with_key(gnutls_privkey_t key, gnutls_digest_algorithm_t digest,
+	const std::string &data, bool hashed, std::string &signature) {
+
+	gnutls_datum_t datum = {(unsigned char*)data.c_str(),
+		(unsigned)data.length()};
+
+	gnutls_datum_t sig;
+	int ret;
+	if (hashed) {
+		MetricTimer timer(sign_hash_seconds);
+		ret = gnutls_privkey_sign_hash(key, digest, 0, &datum, &sig);
+	} else {
+		MetricTimer timer(sign_seconds);
+		ret = gnutls_privkey_sign_data(key, digest, 0, &datum, &sig);
+	}
+	if (ret < GNUTLS_E_SUCCESS) {
+		return ret;
+	}
+
+	signature = base64_encode(sig.data, sig.size);
+	gnutls_free(sig.data);
+
+	return GNUTLS_E_SUCCESS;
+}
+
+/*
+ * La clave se importa una sola vez, así que el PIN se solicita como mucho
+ * una vez y todas las firmas se hacen seguidas sobre la misma sesión.
+ */
+static int sign_batch(const std::string &key_url,
+	gnutls_digest_algorithm_t digest, const std::vector<std::string> &data,
+	bool hashed, std::vector<std::string> &signatures,
+	std::string &algorithm) {
+
+	gnutls_privkey_t key;
+	int ret = session_acquire(key_url, &key);
+	if (ret < GNUTLS_E_SUCCESS) {
+		return ret;
+	}
+
+	signatures.clear();
+	signatures.reserve(data.size());
+	for (std::size_t i = 0; i < data.size(); i++) {
+		std::string signature;
+		ret = sign_with_key(key, digest, data.at(i), hashed,
+			signature);
+		if (ret < GNUTLS_E_SUCCESS) {
+			session_release(key_url, key, i, true);
+			return ret;
+		}
+		signatures.push_back(signature);
+	}
+
+	algorithm = sign_algorithm_name(
+		gnutls_privkey_get_pk_algorithm(key, NULL), digest);
+
+	session_release(key_url, key, data.size(), false);
+
+	return GNUTLS_E_SUCCESS;
+}
+
+int sign_data(const std::string &key_url, gnutls_digest_algorithm_t digest,
+	const std::string &data, std::string &signature,
+	std::string &algorithm) {
+
+	std::vector<std::string> signatures;
+	int ret = sign_data_batch(key_url, digest,
+		std::vector<std::string>(1, data), signatures, algorithm);
+	if (ret < GNUTLS_E_SUCCESS) {
+		return ret;
+	}
+
+	signature = signatures.front();
+
+	return GNUTLS_E_SUCCESS;
+}
+
+int sign_hash(const std::string &key_url, gnutls_digest_algorithm_t digest,
+	const std::string &hash, std::string &signature,
+	std::string &algorithm) {
+
+	if (hash.length() != gnutls_hash_get_len(digest)) {
+		return GNUTLS_E_INVALID_REQUEST;
+	}
+
+	std::vector<std::string> signatures;
+	int ret = sign_batch(key_url, digest, std::vector<std::string>(1, hash),
+		true, signatures, algorithm);
+	if (ret < GNUTLS_E_SUCCESS) {
+		return ret;
+	}
+
+	signature = signatures.front();
+
+	return GNUTLS_E_SUCCESS;
+}
+
+int sign_data_batch(const std::string &key_url,
+	gnutls_digest_algorithm_t digest, const std::vector<std::string> &data,
+	std::vector<std::string> &signatures, std::string &algorithm) {
+
+	return sign_batch(key_url, digest, data, false, signatures, algorithm);
+}
@@ -0,0 +1,66 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef FIRMADOR_SIGN_H
+#define FIRMADOR_SIGN_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <gnutls/crypto.h>
+#include <gnutls/gnutls.h>
+
+/*
+ * Resumen de un documento calculado por trozos a medida que llega, de modo
+ * que la memoria no depende de su tamaño.
+ */
+class SignDigest {
+public:
+	SignDigest() : hash(NULL), algorithm(GNUTLS_DIG_UNKNOWN) {}
+	~SignDigest();
+
+	int init(gnutls_digest_algorithm_t algorithm);
+	bool update(const char *data, std::size_t size);
+	/* Resumen en binario, vacío si no se llamó a init. */
+	std::string finish();
+
+private:
+	SignDigest(const SignDigest &);
+	SignDigest &operator=(const SignDigest &);
+
+	gnutls_hash_hd_t hash;
+	gnutls_digest_algorithm_t algorithm;
+};
+
+gnutls_digest_algorithm_t sign_digest_algorithm(const std::string &name);
+
+int sign_data(const std::string &key_url, gnutls_digest_algorithm_t digest,
+	const std::string &data, std::string &signature,
+	std::string &algorithm);
+
+int sign_hash(const std::string &key_url, gnutls_digest_algorithm_t digest,
+	const std::string &hash, std::string &signature,
+	std::string &algorithm);
+
+int sign_data_batch(const std::string &key_url,
+	gnutls_digest_algorithm_t digest, const std::vector<std::string> &data,
+	std::vector<std::string> &signatures, std::string &algorithm);
+
+#endif
@@ -0,0 +1,221 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "tls.h"
+#include "file.h"
+#include "metrics.h"
+
+#include <cstring>
+#include <memory>
+#include <mutex>
+
+/*
+ * Certificado y clave ya importados, que se entregan a GnuTLS en cada
+ * negociación completa sin volver a decodificarlos. Al renovarlos se conserva
+ * el juego anterior, que puede estar usándose en una negociación en curso.
+ */
+struct tls_credentials_t {
+	gnutls_pcert_st pcert[FIRMADOR_TLS_CHAIN_MAX];
+	unsigned int pcert_size;
+	gnutls_privkey_t key;
+
+	tls_credentials_t() : pcert_size(0), key(NULL) {}
+	~tls_credentials_t() {
+		for (unsigned int i = 0; i < pcert_size; i++) {
+			gnutls_pcert_deinit(&pcert[i]);
+		}
+		if (key != NULL) {
+			gnutls_privkey_deinit(key);
+		}
+	}
+};
+
+static std::mutex tls_mutex;
+static std::shared_ptr<tls_credentials_t> tls_current;
+static std::shared_ptr<tls_credentials_t> tls_previous;
+
+/*
+ * Clave de los tickets de sesión, generada al arrancar. Con ella el navegador
+ * reanuda la sesión en cada nueva conexión, como la de la firma tras la
+ * verificación CORS, sin repetir la negociación completa.
+ */
+static gnutls_datum_t tls_ticket_key = { NULL, 0 };
+
+/* Negociaciones completas y reanudadas. */
+static MetricHistogram tls_full("firmador_tls_handshake_seconds",
+	"resumed=\"false\"", "Negociaciones TLS, desde que se acepta la "
+	"conexión hasta su primera petición.");
+static MetricHistogram tls_resumed("firmador_tls_handshake_seconds",
+	"resumed=\"true\"", "Negociaciones TLS, desde que se acepta la "
+	"conexión hasta su primera petición.");
+
+int tls_init() {
+	return gnutls_session_ticket_key_generate(&tls_ticket_key);
+}
+
+void tls_deinit() {
+	if (tls_ticket_key.data != NULL) {
+		gnutls_memset(tls_ticket_key.data, 0, tls_ticket_key.size);
+		gnutls_free(tls_ticket_key.data);
+		tls_ticket_key.data = NULL;
+		tls_ticket_key.size = 0;
+	}
+
+	std::lock_guard<std::mutex> lock(tls_mutex);
+	tls_current.reset();
+	tls_previous.reset();
+}
+
+/* Comprueba que la clave sea la del certificado por su identificador. */
+static int tls_match(gnutls_pubkey_t certificate, gnutls_privkey_t key) {
+	gnutls_pubkey_t pubkey;
+	int ret = gnutls_pubkey_init(&pubkey);
+	if (ret < GNUTLS_E_SUCCESS) {
+		return ret;
+	}
+
+	unsigned char expected[64];
+	std::size_t expected_size = sizeof(expected);
+	unsigned char actual[64];
+	std::size_t actual_size = sizeof(actual);
+
+	ret = gnutls_pubkey_import_privkey(pubkey, key, 0, 0);
+	if (ret == GNUTLS_E_SUCCESS) {
+		ret = gnutls_pubkey_get_key_id(pubkey, 0, actual,
+			&actual_size);
+	}
+	if (ret == GNUTLS_E_SUCCESS) {
+		ret = gnutls_pubkey_get_key_id(certificate, 0, expected,
+			&expected_size);
+	}
+	gnutls_pubkey_deinit(pubkey);
+	if (ret < GNUTLS_E_SUCCESS) {
+		return ret;
+	}
+
+	if (actual_size != expected_size
+		|| memcmp(actual, expected, actual_size) != 0) {
+		return GNUTLS_E_CERTIFICATE_KEY_MISMATCH;
+	}
+
+	return GNUTLS_E_SUCCESS;
+}
+
+/* Cadena y clave en PEM; sustituyen a las anteriores si son válidas. */
+int tls_credentials(const gnutls_datum_t &certificates,
+	const gnutls_datum_t &key) {
+
+	std::shared_ptr<tls_credentials_t> credentials =
+		std::make_shared<tls_credentials_t>();
+
+	unsigned int size = FIRMADOR_TLS_CHAIN_MAX;
+	int ret = gnutls_pcert_list_import_x509_raw(credentials->pcert, &size,
+		&certificates, GNUTLS_X509_FMT_PEM, 0);
+	if (ret < GNUTLS_E_SUCCESS) {
+		return ret;
+	}
+	credentials->pcert_size = size;
+
+	ret = gnutls_privkey_init(&credentials->key);
+	if (ret < GNUTLS_E_SUCCESS) {
+		credentials->key = NULL;
+		return ret;
+	}
+
+	ret = gnutls_privkey_import_x509_raw(credentials->key, &key,
+		GNUTLS_X509_FMT_PEM, NULL, 0);
+	if (ret < GNUTLS_E_SUCCESS) {
+		return ret;
+	}
+
+	ret = tls_match(credentials->pcert[0].pubkey, credentials->key);
+	if (ret < GNUTLS_E_SUCCESS) {
+		return ret;
+	}
+
+	std::lock_guard<std::mutex> lock(tls_mutex);
+	tls_previous = tls_current;
+	tls_current = credentials;
+
+	return GNUTLS_E_SUCCESS;
+}
+
+/* Certificado y clave facilitados por el instalador o el administrador. */
+int tls_files(const std::string &certificate_path,
+	const std::string &key_path) {
+
+	FileMapping certificate_file(certificate_path);
+	FileMapping key_file(key_path);
+	if (!certificate_file.valid() || !key_file.valid()) {
+		return GNUTLS_E_FILE_ERROR;
+	}
+
+	gnutls_datum_t certificates = {
+		const_cast<unsigned char *>(certificate_file.data()),
+		(unsigned int) certificate_file.size()
+	};
+	gnutls_datum_t key = {
+		const_cast<unsigned char *>(key_file.data()),
+		(unsigned int) key_file.size()
+	};
+
+	return tls_credentials(certificates, key);
+}
+
+/*
+ * Llamada por GnuTLS, a través de libmicrohttpd, en cada negociación
+ * completa. Las reanudadas no la necesitan.
+ */
+int tls_retrieve(gnutls_session_t session, const gnutls_datum_t *req_ca_rdn,
+	int nreqs, const gnutls_pk_algorithm_t *pk_algos, int pk_algos_length,
+	gnutls_pcert_st **pcert, unsigned int *pcert_length,
+	gnutls_privkey_t *privkey) {
+
+	(void) session;
+	(void) req_ca_rdn;
+	(void) nreqs;
+	(void) pk_algos;
+	(void) pk_algos_length;
+
+	std::lock_guard<std::mutex> lock(tls_mutex);
+	if (!tls_current) {
+		return -1;
+	}
+
+	*pcert = tls_current->pcert;
+	*pcert_length = tls_current->pcert_size;
+	*privkey = tls_current->key;
+
+	return 0;
+}
+
+/* Se llama con cada conexión nueva, antes de negociar. */
+void tls_session(gnutls_session_t session) {
+	if (tls_ticket_key.data != NULL) {
+		gnutls_session_ticket_enable_server(session, &tls_ticket_key);
+	}
+}
+
+void tls_handshake(gnutls_session_t session, unsigned long microseconds) {
+	if (gnutls_session_is_resumed(session)) {
+		tls_resumed.observe(microseconds);
+	} else {
+		tls_full.observe(microseconds);
+	}
+}
@@ -0,0 +1,54 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef FIRMADOR_TLS_H
+#define FIRMADOR_TLS_H
+
+#include <string>
+
+#include <gnutls/abstract.h>
+#include <gnutls/gnutls.h>
+
+/*
+ * Solo intercambio de claves efímero con curvas elípticas: DHE obliga a una
+ * exponenciación modular cara en cada negociación y RSA estático no tiene
+ * secreto hacia adelante.
+ */
+#define FIRMADOR_TLS_PRIORITIES "NORMAL:-DHE-RSA:-RSA"
+
+/* Certificados de la cadena que se envía, empezando por el de localhost. */
+#define FIRMADOR_TLS_CHAIN_MAX 4
+
+int tls_init();
+void tls_deinit();
+
+int tls_credentials(const gnutls_datum_t &certificates,
+	const gnutls_datum_t &key);
+int tls_files(const std::string &certificate_path,
+	const std::string &key_path);
+
+int tls_retrieve(gnutls_session_t session, const gnutls_datum_t *req_ca_rdn,
+	int nreqs, const gnutls_pk_algorithm_t *pk_algos, int pk_algos_length,
+	gnutls_pcert_st **pcert, unsigned int *pcert_length,
+	gnutls_privkey_t *privkey);
+
+void tls_session(gnutls_session_t session);
+void tls_handshake(gnutls_session_t session, unsigned long microseconds);
+
+#endif
@@ -0,0 +1,179 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "token.h"
+#include "metrics.h"
+
+#include <memory>
+#include <sstream>
+
+#include <gnutls/pkcs11.h>
+#include <gnutls/x509.h>
+
+static MetricHistogram token_get_url_seconds(FIRMADOR_METRICS_PKCS11,
+	"call=\"token_get_url\"", FIRMADOR_METRICS_PKCS11_HELP);
+static MetricHistogram token_import_seconds(FIRMADOR_METRICS_PKCS11,
+	"call=\"obj_list_import_url2\"", FIRMADOR_METRICS_PKCS11_HELP);
+
+static void certificate_read(gnutls_pkcs11_obj_t obj,
+	std::vector<certificate_t> &certificates) {
+
+	gnutls_x509_crt_t cert;
+	gnutls_x509_crt_init(&cert);
+
+	if (gnutls_x509_crt_import_pkcs11(cert, obj) < GNUTLS_E_SUCCESS) {
+		gnutls_x509_crt_deinit(cert);
+		return;
+	}
+
+	unsigned int keyusage = 0;
+	gnutls_x509_crt_get_key_usage(cert, &keyusage, NULL);
+
+	if (keyusage & GNUTLS_KEY_NON_REPUDIATION) {
+		certificate_t certificate;
+
+		char nombre[32];
+		std::size_t nombre_size = sizeof(nombre);
+		gnutls_x509_crt_get_dn_by_oid(cert,
+			GNUTLS_OID_X520_GIVEN_NAME, 0, 0,
+			nombre, &nombre_size);
+
+		char apellido[80];
+		std::size_t apellido_size = sizeof(apellido);
+		gnutls_x509_crt_get_dn_by_oid(cert,
+			GNUTLS_OID_X520_SURNAME, 0, 0,
+			apellido, &apellido_size);
+
+		char cedula[128];
+		std::size_t cedula_size = sizeof(cedula);
+		gnutls_x509_crt_get_dn_by_oid(cert, "2.5.4.5",
+			0, 0, cedula, &cedula_size);
+
+		unsigned int bits;
+		int algo = gnutls_x509_crt_get_pk_algorithm(cert, &bits);
+		certificate.encryptionAlgorithm =
+			gnutls_pk_algorithm_get_name(
+				(gnutls_pk_algorithm_t)algo);
+
+		std::ostringstream caption;
+		caption << nombre << " " << apellido << " (" << cedula << ")";
+		certificate.caption = caption.str();
+
+		char *obj_url;
+		if (gnutls_pkcs11_obj_export_url(obj,
+			GNUTLS_PKCS11_URL_GENERIC, &obj_url)
+			== GNUTLS_E_SUCCESS) {
+
+			certificate.url = obj_url;
+			gnutls_free(obj_url);
+			certificate.x509 = std::make_shared<certificate_x509_t>(
+				cert);
+			certificates.push_back(certificate);
+			return;
+		}
+	}
+	gnutls_x509_crt_deinit(cert);
+}
+
+int token_urls(std::vector<std::string> &urls) {
+	for (std::size_t i = 0; ; i++) {
+		char* url;
+		int ret;
+		{
+			MetricTimer timer(token_get_url_seconds);
+			ret = gnutls_pkcs11_token_get_url(i,
+				GNUTLS_PKCS11_URL_GENERIC, &url);
+		}
+
+		if (ret == GNUTLS_E_REQUESTED_DATA_NOT_AVAILABLE) {
+			break;
+		}
+
+		if (ret < GNUTLS_E_SUCCESS) {
+			return ret;
+		}
+
+		urls.push_back(url);
+		gnutls_free(url);
+	}
+
+	return GNUTLS_E_SUCCESS;
+}
+
+/*
+ * El número de serie viene en la propia URL del token, por lo que consultarlo
+ * no requiere comunicarse con la tarjeta. Si no lo tiene se usa la URL.
+ */
+std::string token_serial(const std::string &token_url) {
+	char serial[64];
+	std::size_t serial_size = sizeof(serial);
+
+	if (gnutls_pkcs11_token_get_info(token_url.c_str(),
+		GNUTLS_PKCS11_TOKEN_SERIAL, serial, &serial_size)
+		< GNUTLS_E_SUCCESS || serial[0] == 0) {
+		return token_url;
+	}
+
+	return serial;
+}
+
+int token_read(const std::string &token_url,
+	std::vector<certificate_t> &certificates) {
+
+	gnutls_pkcs11_obj_t* obj_list;
+	unsigned int obj_list_size = 0;
+
+	int ret;
+	{
+		MetricTimer timer(token_import_seconds);
+		ret = gnutls_pkcs11_obj_list_import_url2(&obj_list,
+			&obj_list_size, token_url.c_str(),
+			GNUTLS_PKCS11_OBJ_ATTR_CRT_ALL, 0);
+	}
+	if (ret < GNUTLS_E_SUCCESS) {
+		return ret;
+	}
+
+	for (std::size_t i = 0; i < obj_list_size; i++) {
+		certificate_read(obj_list[i], certificates);
+		gnutls_pkcs11_obj_deinit(obj_list[i]);
+	}
+
+	if (obj_list_size > 0) {
+		gnutls_free(obj_list);
+	}
+
+	return GNUTLS_E_SUCCESS;
+}
+
+/*
+ * La URL exportada del objeto certificado lleva "type=cert"; la clave privada
+ * asociada comparte identificador y etiqueta, así que basta cambiar el tipo.
+ */
+std::string token_key_url(const std::string &certificate_url) {
+	std::string url = certificate_url;
+	std::string type = "type=cert";
+	std::size_t pos = url.find(type);
+
+	if (pos != std::string::npos) {
+		url.replace(pos, type.length(), "type=private");
+	}
+
+	return url;
+}
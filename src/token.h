@@ -0,0 +1,34 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef FIRMADOR_TOKEN_H
+#define FIRMADOR_TOKEN_H
+
+#include "certificate.h"
+
+#include <string>
+#include <vector>
+
+int token_urls(std::vector<std::string> &urls);
+std::string token_serial(const std::string &token_url);
+int token_read(const std::string &token_url,
+	std::vector<certificate_t> &certificates);
+std::string token_key_url(const std::string &certificate_url);
+
+#endif
@@ -19,25 +19,116 @@ along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
 
 #include "uuid.h"
 
-#include <cstdio>
-#include <cstdlib>
-#include <ctime>
-#include <iostream>
+#include <chrono>
+#include <cstring>
+
+#include <gnutls/crypto.h>
+
+#define FIRMADOR_UUID_BUFFER 256
+
+static constexpr char uuid_hex[] =
+	"000102030405060708090a0b0c0d0e0f"
+	"101112131415161718191a1b1c1d1e1f"
+	"202122232425262728292a2b2c2d2e2f"
+	"303132333435363738393a3b3c3d3e3f"
+	"404142434445464748494a4b4c4d4e4f"
+	"505152535455565758595a5b5c5d5e5f"
+	"606162636465666768696a6b6c6d6e6f"
+	"707172737475767778797a7b7c7d7e7f"
+	"808182838485868788898a8b8c8d8e8f"
+	"909192939495969798999a9b9c9d9e9f"
+	"a0a1a2a3a4a5a6a7a8a9aaabacadaeaf"
+	"b0b1b2b3b4b5b6b7b8b9babbbcbdbebf"
+	"c0c1c2c3c4c5c6c7c8c9cacbcccdcecf"
+	"d0d1d2d3d4d5d6d7d8d9dadbdcdddedf"
+	"e0e1e2e3e4e5e6e7e8e9eaebecedeeef"
+	"f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff"
+	;
+
+/*
+ * Bytes aleatorios por hilo, pedidos a gnutls_rnd de varios UUID a la vez.
+ * Cada hilo consume los suyos sin bloqueos.
+ */
+static thread_local unsigned char uuid_random[FIRMADOR_UUID_BUFFER];
+static thread_local std::size_t uuid_position = FIRMADOR_UUID_BUFFER;
+
+static int uuid_bytes(unsigned char *bytes, std::size_t size) {
+	if (FIRMADOR_UUID_BUFFER - uuid_position < size) {
+		int ret = gnutls_rnd(GNUTLS_RND_RANDOM, uuid_random,
+			sizeof(uuid_random));
+		if (ret < GNUTLS_E_SUCCESS) {
+			return ret;
+		}
+		uuid_position = 0;
+	}
+
+	memcpy(bytes, uuid_random + uuid_position, size);
+	/* No se deja en memoria lo que ya forma parte de un UUID. */
+	memset(uuid_random + uuid_position, 0, size);
+	uuid_position += size;
+
+	return GNUTLS_E_SUCCESS;
+}
+
+/* Fija versión y variante RFC 4122 y da formato 8-4-4-4-12. */
+static void uuid_format(unsigned char *bytes, unsigned int version,
+	char *out) {
+
+	static constexpr unsigned char dashes[] = {4, 6, 8, 10};
+
+	bytes[6] = (bytes[6] & 0x0F) | (version << 4);
+	bytes[8] = (bytes[8] & 0x3F) | 0x80;
+
+	const unsigned char *dash = dashes;
+	for (unsigned int i = 0; i < 16; i++) {
+		if (dash != dashes + sizeof(dashes) && *dash == i) {
+			*out++ = '-';
+			dash++;
+		}
+		memcpy(out, uuid_hex + bytes[i] * 2, 2);
+		out += 2;
+	}
+}
+
+int uuid_v4(char out[FIRMADOR_UUID_SIZE]) {
+	unsigned char bytes[16];
+
+	int ret = uuid_bytes(bytes, sizeof(bytes));
+	if (ret < GNUTLS_E_SUCCESS) {
+		return ret;
+	}
+	uuid_format(bytes, 4, out);
+
+	return GNUTLS_E_SUCCESS;
+}
+
+int uuid_v7(char out[FIRMADOR_UUID_SIZE]) {
+	unsigned char bytes[16];
+
+	int ret = uuid_bytes(bytes + 6, sizeof(bytes) - 6);
+	if (ret < GNUTLS_E_SUCCESS) {
+		return ret;
+	}
+
+	unsigned long long milliseconds =
+		std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::system_clock::now().time_since_epoch())
+			.count();
+	for (int i = 5; i >= 0; i--) {
+		bytes[i] = milliseconds & 0xFF;
+		milliseconds >>= 8;
+	}
+	uuid_format(bytes, 7, out);
+
+	return GNUTLS_E_SUCCESS;
+}
 
 std::string uuid() {
-	char uuid_cstr[37];
-
-	srand(time(NULL));
-	sprintf(uuid_cstr,
-		"%02x%02x%02x%02x-%02x%02x-%02x%02x"
-		"-%02x%02x-%02x%02x%02x%02x%02x%02x",
-		rand() & 0xFF, rand() & 0xFF, rand() & 0xFF,
-		rand() & 0xFF, rand() & 0xFF, rand() & 0xFF,
-		(rand() & 0x0F) | 0x40, rand() & 0xFF,
-		rand() % 0x3F + 0x80, rand() & 0xFF,
-		rand() & 0xFF, rand() & 0xFF, rand() & 0xFF,
-		rand() & 0xFF, rand() & 0xFF, rand() & 0xFF);
-	std::string uuid(uuid_cstr);
-
-	return uuid;
+	char uuid_cstr[FIRMADOR_UUID_SIZE];
+
+	if (uuid_v4(uuid_cstr) < GNUTLS_E_SUCCESS) {
+		return std::string();
+	}
+
+	return std::string(uuid_cstr, sizeof(uuid_cstr));
 }
@@ -22,6 +22,18 @@ along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
 
 #include <string>
 
+/* Longitud del texto de un UUID, sin terminador. */
+#define FIRMADOR_UUID_SIZE 36
+
+/*
+ * Escriben un UUID versión 4 (aleatorio) o 7 (marca de tiempo en
+ * milisegundos seguida de bits aleatorios) en out, sin reservar memoria.
+ * Devuelven el código de error de gnutls_rnd si no hay aleatoriedad.
+ */
+int uuid_v4(char out[FIRMADOR_UUID_SIZE]);
+int uuid_v7(char out[FIRMADOR_UUID_SIZE]);
+
+/* UUID versión 4 como cadena, vacía en caso de error. */
 std::string uuid();
 
 #endif
@@ -0,0 +1,74 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include "worker.h"
+
+WorkerPool::WorkerPool(std::size_t size) : stopping(false) {
+	for (std::size_t i = 0; i < size; i++) {
+		threads.push_back(std::thread(&WorkerPool::run, this));
+	}
+}
+
+WorkerPool::~WorkerPool() {
+	stop();
+}
+
+void WorkerPool::submit(const std::function<void()> &task) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!stopping) {
+			tasks.push_back(task);
+			condition.notify_one();
+			return;
+		}
+	}
+	task();
+}
+
+/* Termina las tareas pendientes y espera a los hilos; se puede repetir. */
+void WorkerPool::stop() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	condition.notify_all();
+
+	for (std::size_t i = 0; i < threads.size(); i++) {
+		threads.at(i).join();
+	}
+	threads.clear();
+}
+
+void WorkerPool::run() {
+	for (;;) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while (!stopping && tasks.empty()) {
+				condition.wait(lock);
+			}
+			if (tasks.empty()) {
+				return;
+			}
+			task = tasks.front();
+			tasks.pop_front();
+		}
+		task();
+	}
+}
@@ -0,0 +1,57 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef FIRMADOR_WORKER_H
+#define FIRMADOR_WORKER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define FIRMADOR_WORKERS 2
+
+/*
+ * Ejecutor de tareas lentas (operaciones con la tarjeta y diálogos) fuera del
+ * hilo de libmicrohttpd, para que las rutas ligeras sigan respondiendo
+ * mientras se firma. Tras stop() las tareas se ejecutan en el hilo que las
+ * envía, de modo que ninguna conexión suspendida queda sin reanudar.
+ */
+class WorkerPool {
+public:
+	explicit WorkerPool(std::size_t size);
+	~WorkerPool();
+
+	void submit(const std::function<void()> &task);
+	void stop();
+
+private:
+	void run();
+
+	std::vector<std::thread> threads;
+	std::deque<std::function<void()> > tasks;
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool stopping;
+};
+
+#endif
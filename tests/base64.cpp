@@ -0,0 +1,155 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/*
+ * Pruebas de base64 con cada implementación disponible en la CPU: ida y
+ * vuelta para todas las longitudes hasta FIRMADOR_TEST_LENGTH, vectores de
+ * RFC 4648 y rechazo de lo que no es base64 canónico, también dentro de los
+ * bloques que tratan las versiones vectoriales.
+ */
+
+#include "base64.h"
+
+#include <cstdio>
+#include <string>
+
+#define FIRMADOR_TEST_LENGTH 400
+
+static int test_failures = 0;
+
+static void test_fail(const char *kernel, const char *what,
+	const std::string &detail) {
+
+	std::printf("FALLO %s %s: %s\n", kernel, what, detail.c_str());
+	test_failures++;
+}
+
+/* Base64 de referencia, carácter a carácter. */
+static std::string test_encode(const std::string &data) {
+	static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+		"abcdefghijklmnopqrstuvwxyz0123456789+/";
+	std::string out;
+
+	for (std::size_t i = 0; i < data.length(); i += 3) {
+		unsigned int block = (unsigned char) data[i] << 16;
+		if (i + 1 < data.length()) {
+			block |= (unsigned char) data[i + 1] << 8;
+		}
+		if (i + 2 < data.length()) {
+			block |= (unsigned char) data[i + 2];
+		}
+		out += alphabet[block >> 18];
+		out += alphabet[block >> 12 & 0x3F];
+		out += i + 1 < data.length()
+			? alphabet[block >> 6 & 0x3F] : '=';
+		out += i + 2 < data.length() ? alphabet[block & 0x3F] : '=';
+	}
+
+	return out;
+}
+
+static bool test_decode(const std::string &text, std::string &out) {
+	out = "basura";
+
+	return base64_decode(text.data(), text.length(), out);
+}
+
+static void test_kernel(const char *kernel) {
+	static const char *vectors[][2] = {
+		{"", ""}, {"f", "Zg=="}, {"fo", "Zm8="}, {"foo", "Zm9v"},
+		{"foob", "Zm9vYg=="}, {"fooba", "Zm9vYmE="},
+		{"foobar", "Zm9vYmFy"}
+	};
+	std::string out;
+
+	for (std::size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]);
+		i++) {
+		std::string data = vectors[i][0];
+		if (base64_encode((const unsigned char *) data.data(),
+			data.length()) != vectors[i][1]
+			|| !test_decode(vectors[i][1], out) || out != data) {
+			test_fail(kernel, "RFC 4648", vectors[i][1]);
+		}
+	}
+
+	/* Todos los valores de byte y todas las longitudes. */
+	std::string data;
+	for (std::size_t i = 0; i < FIRMADOR_TEST_LENGTH; i++) {
+		data += (char) (i * 167 + 13);
+	}
+	for (std::size_t length = 0; length <= FIRMADOR_TEST_LENGTH;
+		length++) {
+		std::string part = data.substr(0, length);
+		std::string text = base64_encode(
+			(const unsigned char *) part.data(), part.length());
+		if (text != test_encode(part)) {
+			test_fail(kernel, "codificación", text);
+		} else if (!test_decode(text, out) || out != part) {
+			test_fail(kernel, "ida y vuelta", text);
+		}
+	}
+
+	/*
+	 * Un carácter ajeno en cada posición de un texto largo. El relleno
+	 * solo es ajeno antes del final.
+	 */
+	std::string text = test_encode(data.substr(0, 300));
+	const char foreign[] = {'=', '-', '_', ' ', '\n', '.', '\0', '\x80'};
+	for (std::size_t i = 0; i < text.length(); i++) {
+		for (std::size_t j = i + 1 < text.length() ? 0 : 1;
+			j < sizeof(foreign); j++) {
+			std::string bad = text;
+			bad[i] = foreign[j];
+			if (test_decode(bad, out) || !out.empty()) {
+				test_fail(kernel, "carácter ajeno", bad);
+			}
+		}
+	}
+
+	const char *invalid[] = {
+		/* Longitud que no es múltiplo de 4. */
+		"A", "AA", "AAA", "AAAAA", "Zm9vYg=", "Zm9vYmFy=",
+		/* Relleno fuera del final. */
+		"=AAA", "A=AA", "AA=A", "====", "A===", "Zg==Zg==",
+		"Zm8=Zm9v",
+		/* Bits sobrantes distintos de cero. */
+		"Zh==", "Zm9=", "Zm9vYh==", "Zm9vYmF="
+	};
+	for (std::size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]);
+		i++) {
+		if (test_decode(invalid[i], out) || !out.empty()) {
+			test_fail(kernel, "aceptado", invalid[i]);
+		}
+	}
+}
+
+int main() {
+	const char *kernels[] = {"scalar", "ssse3", "avx2"};
+
+	for (std::size_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]);
+		i++) {
+		if (!base64_select(kernels[i])) {
+			std::printf("Sin %s en esta CPU.\n", kernels[i]);
+			continue;
+		}
+		test_kernel(kernels[i]);
+	}
+
+	return test_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,184 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/*
+ * Pruebas del analizador JSON incremental y del de las peticiones de firma:
+ * cada documento se entrega entero, partido en dos por cada posición y byte
+ * a byte, y los eventos deben ser siempre los mismos.
+ */
+
+#include "body.h"
+#include "json.h"
+
+#include <cstdio>
+#include <string>
+
+/* Anota los eventos en una cadena para compararlos. */
+class TestHandler : public JsonHandler {
+public:
+	std::string events;
+
+	virtual bool StartObject() { events += "{"; return true; }
+	virtual bool EndObject() { events += "}"; return true; }
+	virtual bool StartArray() { events += "["; return true; }
+	virtual bool EndArray() { events += "]"; return true; }
+	virtual bool Key(const char *str, std::size_t length) {
+		events += "k:" + std::string(str, length) + ";";
+		return true;
+	}
+	virtual bool String(const char *str, std::size_t length) {
+		events += "s:" + std::string(str, length) + ";";
+		return true;
+	}
+	virtual bool Scalar(const char *str, std::size_t length) {
+		events += "v:" + std::string(str, length) + ";";
+		return true;
+	}
+};
+
+static int test_failures = 0;
+
+static void test_fail(const char *what, const std::string &document,
+	const std::string &detail) {
+
+	std::printf("FALLO %s: %s (%s)\n", what, document.c_str(),
+		detail.c_str());
+	test_failures++;
+}
+
+/* Analiza document en un trozo de first bytes y el resto de step en step. */
+static bool test_parse(const std::string &document, std::size_t first,
+	std::size_t step, std::string &events) {
+
+	TestHandler handler;
+	JsonReader reader(handler);
+	bool ok = reader.feed(document.data(), first);
+
+	for (std::size_t i = first; ok && i < document.length(); i += step) {
+		std::size_t size = document.length() - i < step
+			? document.length() - i : step;
+		ok = reader.feed(document.data() + i, size);
+	}
+	ok = ok && reader.finish();
+	events = handler.events;
+
+	return ok;
+}
+
+static void test_valid(const std::string &document,
+	const std::string &expected) {
+
+	std::string events;
+	if (!test_parse(document, document.length(), 1, events)
+		|| events != expected) {
+		test_fail("entero", document, events);
+	}
+
+	for (std::size_t cut = 0; cut <= document.length(); cut++) {
+		if (!test_parse(document, cut, document.length(), events)
+			|| events != expected) {
+			char detail[32];
+			std::snprintf(detail, sizeof(detail), "corte en %u",
+				(unsigned int) cut);
+			test_fail("partido", document, detail);
+		}
+	}
+
+	if (!test_parse(document, 0, 1, events) || events != expected) {
+		test_fail("byte a byte", document, events);
+	}
+}
+
+static void test_invalid(const std::string &document) {
+	std::string events;
+
+	for (std::size_t cut = 0; cut <= document.length(); cut++) {
+		if (test_parse(document, cut, document.length(), events)) {
+			test_fail("aceptado", document, events);
+			return;
+		}
+	}
+}
+
+static bool test_request(const std::string &document,
+	sign_request_t &request) {
+
+	SignRequestParser parser(request);
+
+	return parser.feed(document.data(), document.length())
+		&& parser.finish();
+}
+
+int main() {
+	test_valid("{\"a\":[1,-0.5,2e10,-3E-2,0,true,false,null],\"b\":{}}",
+		"{k:a;[v:1;v:-0.5;v:2e10;v:-3E-2;v:0;v:true;v:false;"
+		"v:null;]k:b;{}}");
+	test_valid(" [ \"x\\\"\\\\\\/\\n\" , \"\\u00e1\\u20AC\" ] ",
+		"[s:x\"\\/\n;s:\xc3\xa1\xe2\x82\xac;]");
+	test_valid("[\"\\ud83d\\ude00\"]", "[s:\xf0\x9f\x98\x80;]");
+	test_valid("12345", "v:12345;");
+	test_valid("[]", "[]");
+
+	const char *numbers[] = {
+		"01", "-01", "1-2", "1+2", "-", "+1", "1.", ".5", "1.e3",
+		"1e", "1e+", "1E-", "--1", "1.2.3", "1e2e3", "0x10", "00"
+	};
+	for (std::size_t i = 0; i < sizeof(numbers) / sizeof(numbers[0]);
+		i++) {
+		test_invalid(numbers[i]);
+		test_invalid(std::string("[") + numbers[i] + "]");
+		test_invalid(std::string("{\"n\":") + numbers[i] + "}");
+	}
+
+	test_invalid("{\"a\" 1}");
+	test_invalid("{,}");
+	test_invalid("[1,]");
+	test_invalid("[1 2]");
+	test_invalid("[\"\\ud83d\"]");
+	test_invalid("[\"\\x\"]");
+	test_invalid("[tru]");
+	test_invalid("[1]]");
+	test_invalid("{\"a\":1");
+
+	sign_request_t request;
+	if (!test_request("{\"keyId\":\"k\",\"digestAlgorithm\":\"SHA256\","
+		"\"tokenId\":{\"id\":\"t\"},"
+		"\"toBeSigned\":{\"bytes\":\"YQ==\"},"
+		"\"extra\":[1,{\"x\":null}]}", request)
+		|| request.key_id != "k" || request.digest_algorithm != "SHA256"
+		|| request.token_id != "t" || request.to_be_signed.size() != 1
+		|| request.to_be_signed.at(0) != "a") {
+		test_fail("petición", "válida", "campos");
+	}
+
+	const char *requests[] = {
+		"{\"keyId\":1}", "{\"keyId\":null}", "{\"keyId\":[\"k\"]}",
+		"{\"digestAlgorithm\":{}}", "{\"tokenId\":{\"id\":true}}",
+		"{\"toBeSigned\":{\"bytes\":1}}", "{\"toBeSigned\":[1]}"
+	};
+	for (std::size_t i = 0; i < sizeof(requests) / sizeof(requests[0]);
+		i++) {
+		sign_request_t rejected;
+		if (test_request(requests[i], rejected)) {
+			test_fail("petición aceptada", requests[i], "");
+		}
+	}
+
+	return test_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,112 @@
+/* Firmador is a program that communicates web browsers with smartcards.
+
+Copyright (C) 2018 Francisco de la Peña Fernández.
+
+This file is part of Firmador.
+
+Firmador is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Firmador is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Firmador.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/*
+ * Pruebas de PinentryPrompt con un pinentry simulado, un guion de shell que
+ * responde OK a todo y a GETPIN con la línea D de FIRMADOR_TEST_PIN si no
+ * está vacía.
+ */
+
+#ifndef _WIN32
+
+#include "pinentry.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char test_script[] =
+	"#!/bin/sh\n"
+	"echo 'OK Pleased to meet you'\n"
+	"while read line; do\n"
+	"	case \"$line\" in\n"
+	"	GETPIN)\n"
+	"		if [ -n \"$FIRMADOR_TEST_PIN\" ]; then\n"
+	"			echo \"D $FIRMADOR_TEST_PIN\"\n"
+	"		fi\n"
+	"		echo OK;;\n"
+	"	BYE)\n"
+	"		echo OK\n"
+	"		exit 0;;\n"
+	"	*)\n"
+	"		echo OK;;\n"
+	"	esac\n"
+	"done\n";
+
+static int test_failures = 0;
+
+/* PIN que devuelve el prompt con el búfer lleno de basura al empezar. */
+static int test_pin(const std::string &program, const char *answer,
+	std::string &pin) {
+
+	char buffer[32];
+	memset(buffer, 'x', sizeof(buffer));
+	setenv("FIRMADOR_TEST_PIN", answer, 1);
+
+	PinentryPrompt prompt(program);
+	int ret = prompt.pin("Prueba", buffer, sizeof(buffer));
+	buffer[sizeof(buffer) - 1] = 0;
+	pin = buffer;
+
+	return ret;
+}
+
+int main() {
+	char directory[] = "/tmp/firmador-pinentry-XXXXXX";
+	if (mkdtemp(directory) == NULL) {
+		return 99;
+	}
+	std::string program = std::string(directory) + "/pinentry";
+
+	FILE *file = fopen(program.c_str(), "w");
+	if (file == NULL || fputs(test_script, file) < 0
+		|| fclose(file) != 0 || chmod(program.c_str(), 0700) != 0) {
+		return 99;
+	}
+
+	std::string pin;
+	if (test_pin(program, "12%2534", pin) != 0 || pin != "12%34") {
+		printf("FALLO PIN con escapes: %s\n", pin.c_str());
+		test_failures++;
+	}
+
+	/* Un OK sin línea D es un campo vacío, no el contenido previo. */
+	if (test_pin(program, "", pin) != -1 || !pin.empty()) {
+		printf("FALLO PIN vacío: %s\n", pin.c_str());
+		test_failures++;
+	}
+
+	unlink(program.c_str());
+	rmdir(directory);
+
+	return test_failures == 0 ? 0 : 1;
+}
+
+#else
+
+/* pinentry no existe en Windows: la prueba se omite. */
+int main() {
+	return 77;
+}
+
+#endif